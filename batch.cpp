@@ -0,0 +1,112 @@
+#include "batch.h"
+#include "image_io.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <dirent.h>
+#include <sys/stat.h>
+
+// formats stb_image can read
+static bool isImage(const std::string &name)
+{
+    static const char *extensions[] = { "jpg", "jpeg", "png", "bmp", "tga", "gif", "psd", "hdr", "pic", "pnm", "ppm", "pgm", "pfm", "raw" };
+    std::string ext = fileExtension(name);
+    for (size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); ++i)
+    {
+        if (ext == extensions[i])
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool isDirectory(const std::string &path)
+{
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+}
+
+static void addDirectory(const std::string &path, std::vector<std::string> &inputs)
+{
+    DIR *dir = opendir(path.c_str());
+    if (!dir)
+    {
+        std::cerr << "Failed to open input directory: " << path << std::endl;
+        return;
+    }
+
+    std::vector<std::string> names;
+    while (struct dirent *entry = readdir(dir))
+    {
+        std::string name = path + "/" + entry->d_name;
+        if (entry->d_name[0] != '.' && isImage(name) && !isDirectory(name))
+        {
+            names.push_back(name);
+        }
+    }
+    closedir(dir);
+
+    std::sort(names.begin(), names.end());
+    inputs.insert(inputs.end(), names.begin(), names.end());
+}
+
+std::vector<std::string> batchInputs(const std::vector<const char*> &args)
+{
+    std::vector<std::string> inputs;
+    for (size_t i = 0; i < args.size(); ++i)
+    {
+        std::string arg = args[i];
+        if (arg.size() > 1 && arg[0] == '@')
+        {
+            std::ifstream list(arg.substr(1).c_str());
+            if (!list)
+            {
+                std::cerr << "Failed to open input list: " << arg.substr(1) << std::endl;
+                continue;
+            }
+            std::string line;
+            while (std::getline(list, line))
+            {
+                if (!line.empty() && line[line.size() - 1] == '\r')
+                {
+                    line.erase(line.size() - 1);
+                }
+                if (!line.empty())
+                {
+                    inputs.push_back(line);
+                }
+            }
+        }
+        else if (isDirectory(arg))
+        {
+            addDirectory(arg, inputs);
+        }
+        else
+        {
+            inputs.push_back(arg);
+        }
+    }
+    return inputs;
+}
+
+std::string batchOutput(const std::string &directory, const std::string &input)
+{
+    size_t slash = input.find_last_of('/');
+    std::string name = slash == std::string::npos ? input : input.substr(slash + 1);
+
+    std::string ext = fileExtension(name);
+    if (!ext.empty())
+    {
+        name.erase(name.size() - ext.size() - 1);
+    }
+    // the formats there are encoders for are written as they were read, everything else as PPM
+    if (ext == "jpeg")
+    {
+        ext = "jpg";
+    }
+    name += (ext == "jpg" || ext == "png" || ext == "pfm" || ext == "raw") ? "." + ext : ".ppm";
+
+    return directory + "/" + name;
+}
@@ -0,0 +1,14 @@
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <string>
+#include <vector>
+
+// expands the inputs of batch mode into image files
+// an argument is an image, a directory (its images, sorted by name) or @list (one path per line)
+std::vector<std::string> batchInputs(const std::vector<const char*> &args);
+
+// output file of an input in directory: same name, .jpg for JPEG inputs, .png, .pfm and .raw kept and .ppm otherwise
+std::string batchOutput(const std::string &directory, const std::string &input);
+
+#endif
@@ -0,0 +1,129 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <cstdlib>
+
+// nearest-rank percentile of sorted values
+static double percentile(const std::vector<double> &sorted, double p)
+{
+    size_t rank = size_t(std::ceil(p / 100.0 * sorted.size()));
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+Timing summarize(std::vector<double> samples)
+{
+    Timing timing = { int(samples.size()), 0.0, 0.0, 0.0, 0.0 };
+    if (samples.empty())
+    {
+        return timing;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    timing.min = samples.front();
+    timing.median = percentile(samples, 50.0);
+    timing.p99 = percentile(samples, 99.0);
+
+    double sum = 0.0;
+    for (size_t i = 0; i < samples.size(); ++i)
+    {
+        sum += samples[i];
+    }
+    timing.mean = sum / samples.size();
+    return timing;
+}
+
+Timing measure(int warmup, int runs, const std::function<void()> &fn)
+{
+    for (int i = 0; i < warmup; ++i)
+    {
+        fn();
+    }
+
+    std::vector<double> samples;
+    for (int i = 0; i < runs; ++i)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        fn();
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return summarize(samples);
+}
+
+std::vector<unsigned char> syntheticImage(int width, int height, unsigned int seed)
+{
+    std::vector<unsigned char> pixels(size_t(width) * height * 3);
+
+    // xorshift, the same seed always gives the same image
+    unsigned int state = seed ? seed : 1;
+    for (int y = 0; y < height; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+
+            size_t i = (size_t(y) * width + x) * 3;
+            int noise = int(state & 63) - 32;
+            int values[3] = { 255 * x / width, 255 * y / height, 255 * ((x + y) & 255) / 255 };
+            for (int c = 0; c < 3; ++c)
+            {
+                pixels[i + c] = (unsigned char) std::min(255, std::max(0, values[c] + noise));
+            }
+        }
+    }
+    return pixels;
+}
+
+std::vector<float> parseList(const std::string &text)
+{
+    std::vector<float> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (!item.empty())
+        {
+            values.push_back(float(atof(item.c_str())));
+        }
+    }
+    return values;
+}
+
+void writeCSV(std::ostream &out, const std::vector<BenchRecord> &records)
+{
+    out << "implementation,width,height,sigma,radius,runs,min_ms,median_ms,p99_ms,mean_ms,megapixels_per_s,skipped" << std::endl;
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        const BenchRecord &r = records[i];
+        double mpps = r.timing.median > 0.0 ? double(r.width) * r.height / (r.timing.median * 1000.0) : 0.0;
+        out << r.implementation << "," << r.width << "," << r.height << "," << r.sigma << "," << r.radius << ","
+            << r.timing.runs << "," << r.timing.min << "," << r.timing.median << "," << r.timing.p99 << ","
+            << r.timing.mean << "," << mpps << "," << r.skipped << std::endl;
+    }
+}
+
+void writeJSON(std::ostream &out, const std::vector<BenchRecord> &records)
+{
+    out << "[" << std::endl;
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        const BenchRecord &r = records[i];
+        double mpps = r.timing.median > 0.0 ? double(r.width) * r.height / (r.timing.median * 1000.0) : 0.0;
+        out << "  {\"implementation\": \"" << r.implementation << "\", \"width\": " << r.width
+            << ", \"height\": " << r.height << ", \"sigma\": " << r.sigma << ", \"radius\": " << r.radius
+            << ", \"runs\": " << r.timing.runs << ", \"min_ms\": " << r.timing.min
+            << ", \"median_ms\": " << r.timing.median << ", \"p99_ms\": " << r.timing.p99
+            << ", \"mean_ms\": " << r.timing.mean << ", \"megapixels_per_s\": " << mpps;
+        if (!r.skipped.empty())
+        {
+            out << ", \"skipped\": \"" << r.skipped << "\"";
+        }
+        out << "}" << (i + 1 < records.size() ? "," : "") << std::endl;
+    }
+    out << "]" << std::endl;
+}
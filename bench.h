@@ -0,0 +1,48 @@
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <functional>
+
+// statistics of repeated timings in milliseconds
+struct Timing
+{
+    int runs;
+    double min;
+    double median;
+    double p99;
+    double mean;
+};
+
+// one row of the benchmark output
+struct BenchRecord
+{
+    std::string implementation;
+    int width;
+    int height;
+    float sigma;
+    int radius;
+    Timing timing;
+    // empty when the configuration was run, otherwise the reason it was skipped
+    std::string skipped;
+};
+
+// min, nearest-rank median and p99, and mean of the samples
+Timing summarize(std::vector<double> samples);
+
+// calls fn warmup times without timing it, then runs times timed on the wall clock
+// fn has to wait for its own results (e.g. glFinish)
+Timing measure(int warmup, int runs, const std::function<void()> &fn);
+
+// deterministic 8-bit RGB test image, noise on top of gradients so no implementation gets an easy input
+std::vector<unsigned char> syntheticImage(int width, int height, unsigned int seed);
+
+// parses a comma separated list of numbers such as "256,1024,4096"
+std::vector<float> parseList(const std::string &text);
+
+void writeCSV(std::ostream &out, const std::vector<BenchRecord> &records);
+void writeJSON(std::ostream &out, const std::vector<BenchRecord> &records);
+
+#endif
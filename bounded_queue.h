@@ -0,0 +1,67 @@
+#ifndef __BOUNDED_QUEUE_H__
+#define __BOUNDED_QUEUE_H__
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+// queue between two stages of a pipeline
+// push blocks while it is full, so a fast stage can not run arbitrarily far ahead of a slow one
+template <typename T>
+class BoundedQueue
+{
+    public:
+        explicit BoundedQueue(size_t capacity) : capacity(capacity), closed(false) {}
+
+        // returns false if the queue was closed, the item is dropped then
+        bool push(T item)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            not_full.wait(lock, [this]() { return closed || items.size() < capacity; });
+            if (closed)
+            {
+                return false;
+            }
+            items.push_back(std::move(item));
+            lock.unlock();
+            not_empty.notify_one();
+            return true;
+        }
+
+        // returns false once the queue is closed and empty
+        bool pop(T &item)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            not_empty.wait(lock, [this]() { return closed || !items.empty(); });
+            if (items.empty())
+            {
+                return false;
+            }
+            item = std::move(items.front());
+            items.pop_front();
+            lock.unlock();
+            not_full.notify_one();
+            return true;
+        }
+
+        // no more items are coming, waiting consumers drain what is left and stop
+        void close()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                closed = true;
+            }
+            not_empty.notify_all();
+            not_full.notify_all();
+        }
+
+    private:
+        size_t capacity;
+        bool closed;
+        std::deque<T> items;
+        std::mutex mutex;
+        std::condition_variable not_empty;
+        std::condition_variable not_full;
+};
+
+#endif
@@ -0,0 +1,760 @@
+#include "cpu_blur.h"
+#include "cpu_kernels.h"
+#include "fft.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// columns per vertical strip, keeps the rows of the strip in L1/L2
+static const int STRIP_WIDTH = 256;
+
+// blurs one row horizontally, line holds width + 2M pixels
+static void horizontalRow(const CpuKernels &kernels, const unsigned char *row, float *out, float *line, int width, int channels, const std::vector<float> &coeffs)
+{
+    const int M = int(coeffs.size()) / 2;
+
+    // row padded by M clamped pixels on both sides, so the inner loop has no branches
+    for (int x = -M; x < width + M; ++x)
+    {
+        int sx = std::min(std::max(x, 0), width - 1);
+        for (int c = 0; c < channels; ++c)
+        {
+            line[size_t(x + M) * channels + c] = row[sx * channels + c];
+        }
+    }
+
+    kernels.row(line, out, width * channels, channels, coeffs.data(), int(coeffs.size()));
+}
+
+// blurs rows [begin, end) horizontally into the float buffer
+static void horizontalPass(const unsigned char *src, float *dst, int width, int channels, const std::vector<float> &coeffs, int begin, int end)
+{
+    const CpuKernels &kernels = cpuKernels();
+    const int M = int(coeffs.size()) / 2;
+    std::vector<float> line(size_t(width + 2 * M) * channels);
+
+    for (int y = begin; y < end; ++y)
+    {
+        const size_t offset = size_t(y) * width * channels;
+        horizontalRow(kernels, src + offset, dst + offset, line.data(), width, channels, coeffs);
+    }
+}
+
+// blurs columns [begin, end) of rows [top, bottom) vertically into the 8-bit output
+// whole rows of the strip are accumulated at once so memory is read contiguously
+static void verticalPass(const float *src, unsigned char *dst, int width, int height, int channels, const std::vector<float> &coeffs, int begin, int end, int top, int bottom)
+{
+    const CpuKernels &kernels = cpuKernels();
+    const int N = int(coeffs.size());
+    const int M = N / 2;
+    const size_t stride = size_t(width) * channels;
+    const int first = begin * channels;
+    const int count = (end - begin) * channels;
+    std::vector<const float*> rows(N);
+
+    for (int y = top; y < bottom; ++y)
+    {
+        for (int i = 0; i < N; ++i)
+        {
+            int sy = std::min(std::max(y + i - M, 0), height - 1);
+            rows[i] = src + sy * stride + first;
+        }
+        kernels.column(rows.data(), dst + y * stride + first, count, coeffs.data(), N);
+    }
+}
+
+void cpu_separated(const unsigned char *src, unsigned char *dst, int width, int height, int channels, const Kernel &kernel, ThreadPool &pool)
+{
+    const std::vector<float> coeffs = fullWeights(kernel);
+    std::vector<float> intermediate(size_t(width) * height * channels);
+
+    pool.parallelFor(height, [&](int begin, int end)
+    {
+        horizontalPass(src, intermediate.data(), width, channels, coeffs, begin, end);
+    });
+
+    // narrow images do not have enough strips for all threads, so strips are also cut into row bands
+    const int strips = (width + STRIP_WIDTH - 1) / STRIP_WIDTH;
+    const int bands = std::min(height, std::max(1, (pool.size() * 4 + strips - 1) / strips));
+    const int band_height = (height + bands - 1) / bands;
+    pool.parallelFor(strips * bands, [&](int begin, int end)
+    {
+        for (int i = begin; i < end; ++i)
+        {
+            int x0 = (i % strips) * STRIP_WIDTH;
+            int x1 = std::min(width, x0 + STRIP_WIDTH);
+            int y0 = (i / strips) * band_height;
+            int y1 = std::min(height, y0 + band_height);
+            verticalPass(intermediate.data(), dst, width, height, channels, coeffs, x0, x1, y0, y1);
+        }
+    });
+}
+
+StreamingBlur::StreamingBlur(int width, int height, int channels, const Kernel &kernel, int block)
+    : width(width), height(height), channels(channels), coeffs(fullWeights(kernel)), pushed(0), pulled(0)
+{
+    // the rows the next row to pull reaches up to, plus room for the block pushed next
+    capacity = int(coeffs.size()) - 1 + block;
+    ring.resize(size_t(capacity) * width * channels);
+}
+
+int StreamingBlur::ready() const
+{
+    return pushed == height ? height : std::max(0, pushed - int(coeffs.size()) / 2);
+}
+
+void StreamingBlur::push(const unsigned char *rows, int count, ThreadPool &pool)
+{
+    const size_t stride = size_t(width) * channels;
+    const int M = int(coeffs.size()) / 2;
+    pool.parallelFor(count, [&](int begin, int end)
+    {
+        std::vector<float> line(size_t(width + 2 * M) * channels);
+        for (int i = begin; i < end; ++i)
+        {
+            float *out = ring.data() + size_t((pushed + i) % capacity) * stride;
+            horizontalRow(cpuKernels(), rows + i * stride, out, line.data(), width, channels, coeffs);
+        }
+    });
+    pushed += count;
+}
+
+int StreamingBlur::pull(unsigned char *rows, int count, ThreadPool &pool)
+{
+    count = std::min(count, ready() - pulled);
+    if (count <= 0)
+    {
+        return 0;
+    }
+
+    const int N = int(coeffs.size());
+    const int M = N / 2;
+    const size_t stride = size_t(width) * channels;
+    const int strips = (width + STRIP_WIDTH - 1) / STRIP_WIDTH;
+    pool.parallelFor(strips * count, [&](int begin, int end)
+    {
+        std::vector<const float*> taps(N);
+        for (int i = begin; i < end; ++i)
+        {
+            const int first = (i % strips) * STRIP_WIDTH * channels;
+            const int last = std::min(width, (i % strips + 1) * STRIP_WIDTH) * channels;
+            const int y = pulled + i / strips;
+            for (int k = 0; k < N; ++k)
+            {
+                int sy = std::min(std::max(y + k - M, 0), height - 1);
+                taps[k] = ring.data() + size_t(sy % capacity) * stride + first;
+            }
+            cpuKernels().column(taps.data(), rows + size_t(y - pulled) * stride + first, last - first, coeffs.data(), N);
+        }
+    });
+    pulled += count;
+    return count;
+}
+
+// the vertical box passes of a strip run back to back in a buffer of about this many floats, so it stays in cache
+static const size_t BOX_STRIP_FLOATS = 256 * 1024;
+
+// box blur of one line of interleaved pixels
+// in and out hold pad clamped pixels on both sides of the line, in has to have them filled
+static void boxLine(const float *in, float *out, int width, int channels, int pad, int radius)
+{
+    const float scale = 1.0f / float(2 * radius + 1);
+    const float *line = in + pad * channels;
+    float *result = out + pad * channels;
+
+    // window of the first pixel
+    float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int i = -radius; i <= radius; ++i)
+    {
+        for (int c = 0; c < channels; ++c)
+        {
+            sum[c] += line[i * channels + c];
+        }
+    }
+
+    const int entering = (radius + 1) * channels;
+    const int leaving = radius * channels;
+    for (int k = 0; k < width * channels; k += channels)
+    {
+        for (int c = 0; c < channels; ++c)
+        {
+            result[k + c] = sum[c] * scale;
+            sum[c] += line[k + c + entering] - line[k + c - leaving];
+        }
+    }
+
+    // the padding of the result is the clamped edge again for the next box
+    for (int i = 1; i <= pad; ++i)
+    {
+        for (int c = 0; c < channels; ++c)
+        {
+            result[-i * channels + c] = result[c];
+            result[(width - 1 + i) * channels + c] = result[(width - 1) * channels + c];
+        }
+    }
+}
+
+// box blur of count values per row over all rows, whole rows are summed at once so memory is read contiguously
+// the last pass writes rounded bytes to bytes instead of floats to out
+static void boxColumns(const float *in, size_t in_stride, float *out, unsigned char *bytes, size_t out_stride, int count, int height, int radius)
+{
+    const float scale = 1.0f / float(2 * radius + 1);
+    std::vector<float> sum(count);
+
+    for (int k = 0; k < count; ++k)
+    {
+        sum[k] = float(radius + 1) * in[k];
+    }
+    for (int i = 1; i <= radius; ++i)
+    {
+        const float *row = in + std::min(i, height - 1) * in_stride;
+        for (int k = 0; k < count; ++k)
+        {
+            sum[k] += row[k];
+        }
+    }
+
+    for (int y = 0; y < height; ++y)
+    {
+        if (bytes)
+        {
+            unsigned char *row = bytes + y * out_stride;
+            for (int k = 0; k < count; ++k)
+            {
+                row[k] = (unsigned char) std::min(255.0f, sum[k] * scale + 0.5f);
+            }
+        }
+        else
+        {
+            float *row = out + y * out_stride;
+            for (int k = 0; k < count; ++k)
+            {
+                row[k] = sum[k] * scale;
+            }
+        }
+
+        const float *entering = in + std::min(y + radius + 1, height - 1) * in_stride;
+        const float *leaving = in + std::max(y - radius, 0) * in_stride;
+        for (int k = 0; k < count; ++k)
+        {
+            sum[k] += entering[k] - leaving[k];
+        }
+    }
+}
+
+void cpu_box(const unsigned char *src, unsigned char *dst, int width, int height, int channels, const Kernel &kernel, ThreadPool &pool)
+{
+    const std::vector<int> &radii = kernel.box_radii;
+    const size_t stride = size_t(width) * channels;
+    std::vector<float> image(size_t(height) * stride);
+
+    // all horizontal boxes of a row run back to back while the row is in cache
+    // the row is padded with clamped pixels so that the running sums need no bounds checks
+    const int pad = *std::max_element(radii.begin(), radii.end()) + 1;
+    pool.parallelFor(height, [&](int begin, int end)
+    {
+        std::vector<float> a(size_t(width + 2 * pad) * channels), b(a.size());
+        for (int y = begin; y < end; ++y)
+        {
+            const unsigned char *row = src + y * stride;
+            for (int x = -pad; x < width + pad; ++x)
+            {
+                int sx = std::min(std::max(x, 0), width - 1);
+                for (int c = 0; c < channels; ++c)
+                {
+                    a[size_t(x + pad) * channels + c] = row[sx * channels + c];
+                }
+            }
+            for (size_t i = 0; i < radii.size(); ++i)
+            {
+                boxLine(a.data(), b.data(), width, channels, pad, radii[i]);
+                a.swap(b);
+            }
+            std::copy(a.begin() + pad * channels, a.begin() + (pad + width) * channels, image.begin() + y * stride);
+        }
+    });
+
+    // vertical boxes need the whole column of the previous one, so every strip of columns goes through all of them
+    // in its own buffers before the next strip is started
+    const int boxes = int(radii.size());
+    const int strip_width = std::max(1, std::min(width, int(BOX_STRIP_FLOATS / (size_t(height) * channels))));
+    const int strips = (width + strip_width - 1) / strip_width;
+    pool.parallelFor(strips, [&](int begin, int end)
+    {
+        std::vector<float> a(size_t(strip_width) * channels * height), b(a.size());
+        for (int s = begin; s < end; ++s)
+        {
+            const int x0 = s * strip_width;
+            const int count = (std::min(width, x0 + strip_width) - x0) * channels;
+
+            const float *in = image.data() + x0 * channels;
+            size_t in_stride = stride;
+            for (int i = 0; i < boxes; ++i)
+            {
+                if (i + 1 == boxes)
+                {
+                    boxColumns(in, in_stride, NULL, dst + x0 * channels, stride, count, height, radii[i]);
+                }
+                else
+                {
+                    boxColumns(in, in_stride, a.data(), NULL, count, count, height, radii[i]);
+                    a.swap(b);
+                    in = b.data();
+                    in_stride = count;
+                }
+            }
+        }
+    });
+}
+
+// y[n] = b * x[n] + a1 * y[n - 1] + a2 * y[n - 2] + a3 * y[n - 3], run forward and then backward
+struct IirFilter
+{
+    double b;
+    double a1, a2, a3;
+    // state of the backward filter at the right edge from the last three forward outputs
+    double m[9];
+};
+
+// coefficients of "Recursive Gabor filtering" (Young, van Vliet, van Ginkel 2002)
+// and the boundary matrix of "Boundary conditions for Young - van Vliet recursive filtering" (Triggs, Sdika 2006)
+static IirFilter iirFilter(float sigma)
+{
+    const double m0 = 1.16680, m1 = 1.10783, m2 = 1.40586;
+    const double q = sigma < 3.556 ? -0.2568 + 0.5784 * sigma + 0.0561 * sigma * sigma : 2.5091 + 0.9804 * (sigma - 3.556);
+    const double scale = (m0 + q) * (m1 * m1 + m2 * m2 + 2.0 * m1 * q + q * q);
+
+    IirFilter f;
+    f.a1 = q * (2.0 * m0 * m1 + m1 * m1 + m2 * m2 + (2.0 * m0 + 4.0 * m1) * q + 3.0 * q * q) / scale;
+    f.a2 = -q * q * (m0 + 2.0 * m1 + 3.0 * q) / scale;
+    f.a3 = q * q * q / scale;
+    f.b = 1.0 - (f.a1 + f.a2 + f.a3);
+
+    const double a1 = f.a1, a2 = f.a2, a3 = f.a3;
+    const double norm = 1.0 / ((1.0 + a1 - a2 + a3) * (1.0 - a1 - a2 - a3) * (1.0 + a2 + (a1 - a3) * a3));
+    f.m[0] = norm * (-a3 * a1 + 1.0 - a3 * a3 - a2);
+    f.m[1] = norm * (a3 + a1) * (a2 + a3 * a1);
+    f.m[2] = norm * a3 * (a1 + a3 * a2);
+    f.m[3] = norm * (a1 + a3 * a2);
+    f.m[4] = -norm * (a2 - 1.0) * (a2 + a3 * a1);
+    f.m[5] = -norm * a3 * (a3 * a1 + a3 * a3 + a2 - 1.0);
+    f.m[6] = norm * (a3 * a1 + a2 + a1 * a1 - a2 * a2);
+    f.m[7] = norm * (a1 * a2 + a3 * a2 * a2 - a1 * a3 * a3 - a3 * a3 * a3 - a3 * a2 + a3);
+    f.m[8] = norm * a3 * (a1 + a3 * a2);
+    return f;
+}
+
+// backward outputs at n - 1, n and n + 1 past the last sample n - 1, as if the input went on with edge forever
+// w0, w1 and w2 are the forward outputs at n - 1, n - 2 and n - 3
+static void iirRightEdge(const IirFilter &f, double w0, double w1, double w2, double edge, double y[3])
+{
+    const double d0 = w0 - edge, d1 = w1 - edge, d2 = w2 - edge;
+    for (int k = 0; k < 3; ++k)
+    {
+        y[k] = edge + f.b * (f.m[3 * k] * d0 + f.m[3 * k + 1] * d1 + f.m[3 * k + 2] * d2);
+    }
+}
+
+// filters one channel of a line of count samples step apart into out, line holds the forward outputs afterwards
+static void iirLine(const IirFilter &f, const unsigned char *in, double *line, float *out, int count, int step)
+{
+    const double edge = in[0];
+    double w1 = edge, w2 = edge, w3 = edge;
+    for (int n = 0; n < count; ++n)
+    {
+        double w = f.b * in[n * step] + f.a1 * w1 + f.a2 * w2 + f.a3 * w3;
+        line[n] = w;
+        w3 = w2;
+        w2 = w1;
+        w1 = w;
+    }
+
+    double y[3];
+    iirRightEdge(f, w1, w2, w3, in[(count - 1) * step], y);
+    double y1 = y[0], y2 = y[1], y3 = y[2];
+    out[(count - 1) * step] = float(y1);
+    for (int n = count - 2; n >= 0; --n)
+    {
+        double v = f.b * line[n] + f.a1 * y1 + f.a2 * y2 + f.a3 * y3;
+        out[n * step] = float(v);
+        y3 = y2;
+        y2 = y1;
+        y1 = v;
+    }
+}
+
+// filters count values per row over all rows, every value is the same step of its own column
+// the forward outputs go to forward, the rounded result to out
+static void iirColumns(const IirFilter &f, const float *in, size_t in_stride, float *forward, unsigned char *out, size_t out_stride, int count, int height)
+{
+    // the last three outputs of every column
+    std::vector<double> s1(in, in + count), s2(s1), s3(s1);
+
+    for (int y = 0; y < height; ++y)
+    {
+        const float *row = in + y * in_stride;
+        float *w = forward + size_t(y) * count;
+        for (int k = 0; k < count; ++k)
+        {
+            double v = f.b * row[k] + f.a1 * s1[k] + f.a2 * s2[k] + f.a3 * s3[k];
+            w[k] = float(v);
+            s3[k] = s2[k];
+            s2[k] = s1[k];
+            s1[k] = v;
+        }
+    }
+
+    const float *last = in + (height - 1) * in_stride;
+    for (int k = 0; k < count; ++k)
+    {
+        double y[3];
+        iirRightEdge(f, s1[k], s2[k], s3[k], last[k], y);
+        s1[k] = y[0];
+        s2[k] = y[1];
+        s3[k] = y[2];
+        out[(height - 1) * out_stride + k] = (unsigned char) std::min(255.0, std::max(0.0, y[0] + 0.5));
+    }
+
+    for (int y = height - 2; y >= 0; --y)
+    {
+        const float *w = forward + size_t(y) * count;
+        unsigned char *row = out + y * out_stride;
+        for (int k = 0; k < count; ++k)
+        {
+            double v = f.b * w[k] + f.a1 * s1[k] + f.a2 * s2[k] + f.a3 * s3[k];
+            row[k] = (unsigned char) std::min(255.0, std::max(0.0, v + 0.5));
+            s3[k] = s2[k];
+            s2[k] = s1[k];
+            s1[k] = v;
+        }
+    }
+}
+
+void cpu_iir(const unsigned char *src, unsigned char *dst, int width, int height, int channels, const Kernel &kernel, ThreadPool &pool)
+{
+    const IirFilter f = iirFilter(kernel.sigma);
+    const size_t stride = size_t(width) * channels;
+    std::vector<float> image(size_t(height) * stride);
+
+    pool.parallelFor(height, [&](int begin, int end)
+    {
+        std::vector<double> line(width);
+        for (int y = begin; y < end; ++y)
+        {
+            for (int c = 0; c < channels; ++c)
+            {
+                iirLine(f, src + y * stride + c, line.data(), image.data() + y * stride + c, width, channels);
+            }
+        }
+    });
+
+    // same strips as the vertical box passes, the forward outputs of a strip stay in cache for the backward pass
+    const int strip_width = std::max(1, std::min(width, int(BOX_STRIP_FLOATS / (size_t(height) * channels))));
+    const int strips = (width + strip_width - 1) / strip_width;
+    pool.parallelFor(strips, [&](int begin, int end)
+    {
+        std::vector<float> forward(size_t(strip_width) * channels * height);
+        for (int s = begin; s < end; ++s)
+        {
+            const int x0 = s * strip_width;
+            const int count = (std::min(width, x0 + strip_width) - x0) * channels;
+            iirColumns(f, image.data() + x0 * channels, stride, forward.data(), dst + x0 * channels, stride, count, height);
+        }
+    });
+}
+
+// longest transform of a tile, longer ones transform less overlap but no longer fit the caches
+static const int FFT_MAX_LENGTH = 2048;
+
+// columns of a tile gathered at once, so its rows are read in whole cache lines
+static const int FFT_COLUMN_BLOCK = 16;
+
+// transform length along one axis of the clamped image, extent samples long, for a kernel of taps samples
+// the tiles are length - taps + 1 long, picks the length with the least work for all of them
+static int fftLength(int extent, int taps)
+{
+    const int largest = std::min(std::max(FFT_MAX_LENGTH, fftSize(2 * taps)), fftSize(extent + taps - 1));
+    int best = 0;
+    double best_cost = 0.0;
+    for (int length = fftSize(taps); length <= largest; length = fftSize(length + 1))
+    {
+        const int tile = length - taps + 1;
+        const double cost = double((extent + tile - 1) / tile) * length * std::log2(double(length));
+        if (best == 0 || cost < best_cost)
+        {
+            best = length;
+            best_cost = cost;
+        }
+    }
+    return best;
+}
+
+// transforms the columns of the rows x width plane, multiplies them with the spectrum and transforms them back
+// without a spectrum the columns are only transformed
+static void filterColumns(const Fft &fft, Complex *plane, int width, const Complex *spectrum, ThreadPool &pool)
+{
+    const int rows = fft.size();
+    const int blocks = (width + FFT_COLUMN_BLOCK - 1) / FFT_COLUMN_BLOCK;
+    pool.parallelFor(blocks, [&](int begin, int end)
+    {
+        std::vector<Complex> columns(size_t(rows) * FFT_COLUMN_BLOCK), scratch(rows);
+        for (int b = begin; b < end; ++b)
+        {
+            const int x0 = b * FFT_COLUMN_BLOCK;
+            const int count = std::min(FFT_COLUMN_BLOCK, width - x0);
+            for (int y = 0; y < rows; ++y)
+            {
+                for (int c = 0; c < count; ++c)
+                {
+                    columns[size_t(c) * rows + y] = plane[size_t(y) * width + x0 + c];
+                }
+            }
+
+            for (int c = 0; c < count; ++c)
+            {
+                Complex *column = &columns[size_t(c) * rows];
+                fft.transform(column, scratch.data(), false);
+                if (spectrum)
+                {
+                    for (int y = 0; y < rows; ++y)
+                    {
+                        column[y] = multiply(column[y], spectrum[size_t(y) * width + x0 + c]);
+                    }
+                    fft.transform(column, scratch.data(), true);
+                }
+            }
+
+            for (int y = 0; y < rows; ++y)
+            {
+                for (int c = 0; c < count; ++c)
+                {
+                    plane[size_t(y) * width + x0 + c] = columns[size_t(c) * rows + y];
+                }
+            }
+        }
+    });
+}
+
+// convolves with the kernel_width x kernel_height taps through 2d transforms of tiles
+static void fftConvolve(const unsigned char *src, unsigned char *dst, int width, int height, int channels,
+                        const std::vector<float> &taps, int kernel_width, int kernel_height, ThreadPool &pool)
+{
+    // the clamped image starts kernel_width - 1 - center pixels left of the image and ends center pixels right of it,
+    // its convolution at x + kernel_width - 1 is the result at x
+    const int left = kernel_width - 1 - kernel_width / 2;
+    const int bottom = kernel_height - 1 - kernel_height / 2;
+    const int extent_x = width + kernel_width - 1;
+    const int extent_y = height + kernel_height - 1;
+
+    const Fft row_fft(fftLength(extent_x, kernel_width));
+    const Fft column_fft(fftLength(extent_y, kernel_height));
+    const int nx = row_fft.size(), ny = column_fft.size();
+    const int tile_x = nx - kernel_width + 1, tile_y = ny - kernel_height + 1;
+
+    // two channels go into the real and imaginary part of one plane, the kernel is real so they do not mix
+    const int planes = (channels + 1) / 2;
+    const size_t plane_size = size_t(nx) * ny;
+
+    // spectrum of the kernel, divided by nx * ny because the inverse transforms are not
+    std::vector<Complex> spectrum(plane_size);
+    const float scale = 1.0f / (float(nx) * float(ny));
+    pool.parallelFor(kernel_height, [&](int begin, int end)
+    {
+        std::vector<Complex> scratch(nx);
+        for (int y = begin; y < end; ++y)
+        {
+            Complex *row = &spectrum[size_t(y) * nx];
+            for (int x = 0; x < kernel_width; ++x)
+            {
+                row[x] = taps[size_t(y) * kernel_width + x] * scale;
+            }
+            row_fft.transform(row, scratch.data(), false);
+        }
+    });
+    filterColumns(column_fft, spectrum.data(), nx, NULL, pool);
+
+    std::vector<Complex> tile(plane_size * planes);
+    std::vector<float> sum(size_t(width) * height * channels, 0.0f);
+
+    for (int ty = 0; ty < extent_y; ty += tile_y)
+    {
+        for (int tx = 0; tx < extent_x; tx += tile_x)
+        {
+            const int rows = std::min(tile_y, extent_y - ty);
+            const int columns = std::min(tile_x, extent_x - tx);
+
+            // clamped pixels of the tile, zero padded to the transform size, rows transformed
+            pool.parallelFor(planes * ny, [&](int begin, int end)
+            {
+                std::vector<Complex> scratch(nx);
+                for (int i = begin; i < end; ++i)
+                {
+                    const int p = i / ny, r = i % ny;
+                    Complex *row = &tile[p * plane_size + size_t(r) * nx];
+                    std::fill(row, row + nx, Complex(0.0f, 0.0f));
+                    if (r >= rows)
+                    {
+                        continue;
+                    }
+
+                    const int y = std::min(std::max(ty + r - bottom, 0), height - 1);
+                    const unsigned char *line = src + size_t(y) * width * channels;
+                    const bool pair = 2 * p + 1 < channels;
+                    for (int c = 0; c < columns; ++c)
+                    {
+                        const int x = std::min(std::max(tx + c - left, 0), width - 1);
+                        const unsigned char *pixel = line + x * channels + 2 * p;
+                        row[c] = Complex(pixel[0], pair ? pixel[1] : 0);
+                    }
+                    row_fft.transform(row, scratch.data(), false);
+                }
+            });
+
+            for (int p = 0; p < planes; ++p)
+            {
+                filterColumns(column_fft, &tile[p * plane_size], nx, spectrum.data(), pool);
+            }
+
+            // rows that land in the image are transformed back and added, every row goes to a different image row
+            const int first = std::max(0, kernel_height - 1 - ty);
+            const int last = std::min(ny, height + kernel_height - 1 - ty);
+            pool.parallelFor(std::max(0, last - first), [&](int begin, int end)
+            {
+                std::vector<Complex> scratch(nx);
+                for (int r = first + begin; r < first + end; ++r)
+                {
+                    const int y = ty + r - (kernel_height - 1);
+                    float *line = &sum[size_t(y) * width * channels];
+                    for (int p = 0; p < planes; ++p)
+                    {
+                        Complex *row = &tile[p * plane_size + size_t(r) * nx];
+                        row_fft.transform(row, scratch.data(), true);
+
+                        const bool pair = 2 * p + 1 < channels;
+                        const int c0 = std::max(0, kernel_width - 1 - tx);
+                        const int c1 = std::min(nx, width + kernel_width - 1 - tx);
+                        for (int c = c0; c < c1; ++c)
+                        {
+                            float *pixel = line + (tx + c - (kernel_width - 1)) * channels + 2 * p;
+                            pixel[0] += row[c].real();
+                            if (pair)
+                            {
+                                pixel[1] += row[c].imag();
+                            }
+                        }
+                    }
+                }
+            });
+        }
+    }
+
+    const size_t stride = size_t(width) * channels;
+    pool.parallelFor(height, [&](int begin, int end)
+    {
+        for (size_t i = begin * stride; i < end * stride; ++i)
+        {
+            dst[i] = (unsigned char) std::min(255.0f, std::max(0.0f, sum[i] + 0.5f));
+        }
+    });
+}
+
+static inline void storeSample(float value, float *target)
+{
+    *target = value;
+}
+
+static inline void storeSample(float value, unsigned char *target)
+{
+    *target = (unsigned char) std::min(255.0f, std::max(0.0f, value + 0.5f));
+}
+
+// convolves every row with the symmetric weights through 1d transforms of overlapping segments
+// the result is stored transposed, row y of the width x height image becomes column y of the height x width one
+template <typename In, typename Out>
+static void fftRowsTransposed(const In *src, Out *dst, int width, int height, int channels, const std::vector<float> &weights, ThreadPool &pool)
+{
+    const int taps = int(weights.size());
+    const int radius = taps / 2;
+    const int extent = width + taps - 1;
+    const Fft fft(fftLength(extent, taps));
+    const int n = fft.size();
+    const int segment = n - taps + 1;
+    const int planes = (channels + 1) / 2;
+
+    std::vector<Complex> spectrum(n), scratch(n);
+    for (int i = 0; i < taps; ++i)
+    {
+        spectrum[i] = weights[i] / float(n);
+    }
+    fft.transform(spectrum.data(), scratch.data(), false);
+
+    pool.parallelFor(height, [&](int begin, int end)
+    {
+        std::vector<Complex> buffer(n), scratch(n), sum(size_t(width) * planes);
+        for (int y = begin; y < end; ++y)
+        {
+            const In *row = src + size_t(y) * width * channels;
+            std::fill(sum.begin(), sum.end(), Complex(0.0f, 0.0f));
+
+            for (int p = 0; p < planes; ++p)
+            {
+                const bool pair = 2 * p + 1 < channels;
+                Complex *line = &sum[size_t(p) * width];
+                for (int start = 0; start < extent; start += segment)
+                {
+                    // the row extended by radius clamped pixels on both sides, zero padded to the transform size
+                    const int count = std::min(segment, extent - start);
+                    for (int i = 0; i < count; ++i)
+                    {
+                        const int x = std::min(std::max(start + i - radius, 0), width - 1);
+                        const In *pixel = row + x * channels + 2 * p;
+                        buffer[i] = Complex(float(pixel[0]), pair ? float(pixel[1]) : 0.0f);
+                    }
+                    std::fill(buffer.begin() + count, buffer.end(), Complex(0.0f, 0.0f));
+
+                    fft.transform(buffer.data(), scratch.data(), false);
+                    for (int i = 0; i < n; ++i)
+                    {
+                        buffer[i] = multiply(buffer[i], spectrum[i]);
+                    }
+                    fft.transform(buffer.data(), scratch.data(), true);
+
+                    // position start + i of the convolution is the result at start + i - taps + 1
+                    const int first = std::max(0, taps - 1 - start);
+                    const int last = std::min(n, width + taps - 1 - start);
+                    for (int i = first; i < last; ++i)
+                    {
+                        line[start + i - taps + 1] += buffer[i];
+                    }
+                }
+            }
+
+            for (int x = 0; x < width; ++x)
+            {
+                Out *target = dst + (size_t(x) * height + y) * channels;
+                for (int c = 0; c < channels; ++c)
+                {
+                    const Complex &value = sum[size_t(c / 2) * width + x];
+                    storeSample(c % 2 ? value.imag() : value.real(), target + c);
+                }
+            }
+        }
+    });
+}
+
+void cpu_fft(const unsigned char *src, unsigned char *dst, int width, int height, int channels, const Kernel &kernel, ThreadPool &pool)
+{
+    if (!kernel.psf.empty())
+    {
+        fftConvolve(src, dst, width, height, channels, kernel.psf, kernel.psf_width, kernel.psf_height, pool);
+        return;
+    }
+
+    // the gaussian is separable, rows and then columns with 1d transforms cost far less than 2d ones
+    // the first pass leaves the image transposed, so the second one also works on rows
+    const std::vector<float> weights = fullWeights(kernel);
+    std::vector<float> transposed(size_t(width) * height * channels);
+    fftRowsTransposed(src, transposed.data(), width, height, channels, weights, pool);
+    fftRowsTransposed(transposed.data(), dst, height, width, channels, weights, pool);
+}
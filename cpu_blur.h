@@ -0,0 +1,63 @@
+#ifndef __CPU_BLUR_H__
+#define __CPU_BLUR_H__
+
+#include "thread_pool.h"
+#include "kernel.h"
+
+#include <vector>
+
+// two pass gaussian filter on the cpu - O(2n)
+// same filter as separated.fragmentshader, edges are clamped
+// horizontal pass is split into row bands, vertical pass into column strips
+// src and dst are interleaved 8-bit images and must not overlap
+void cpu_separated(const unsigned char *src, unsigned char *dst, int width, int height, int channels, const Kernel &kernel, ThreadPool &pool);
+
+// separated gaussian of an image that arrives a few rows at a time - O(width * radius) memory
+// every pushed row is blurred horizontally into a ring of the last 2M + block rows and a row is blurred
+// vertically as soon as the M rows below it are in, so results come out M rows behind the input
+// same result as cpu_separated without the fft hand-off, edges are clamped
+class StreamingBlur
+{
+    public:
+        // rows are pushed at most block at a time
+        StreamingBlur(int width, int height, int channels, const Kernel &kernel, int block);
+
+        // blurs the next count rows (top-down) horizontally, the rows ready before have to be pulled first
+        void push(const unsigned char *rows, int count, ThreadPool &pool);
+
+        // blurs up to count of the ready rows vertically into rows, returns how many
+        int pull(unsigned char *rows, int count, ThreadPool &pool);
+
+    private:
+        int width, height, channels;
+        std::vector<float> coeffs;
+        int capacity; // rows in the ring, row y is kept at y % capacity
+        std::vector<float> ring;
+        int pushed, pulled;
+
+        // rows whose vertical window is complete
+        int ready() const;
+};
+
+// successive box blurs approximating the gaussian - O(1) per pixel for any sigma
+// every box keeps a running sum that gains the pixel entering the window and loses the one leaving it
+// radii come from kernel.box_radii, edges are clamped
+void cpu_box(const unsigned char *src, unsigned char *dst, int width, int height, int channels, const Kernel &kernel, ThreadPool &pool);
+
+// recursive gaussian on the cpu (Young, van Vliet and van Ginkel) - O(1) per pixel for any sigma
+// a third order causal and anticausal filter per row, columns are filtered in strips so whole rows are processed at once
+// edges are clamped with the boundary conditions of Triggs and Sdika, kernel.radius is not used
+void cpu_iir(const unsigned char *src, unsigned char *dst, int width, int height, int channels, const Kernel &kernel, ThreadPool &pool);
+
+// radius from which cpu_fft is faster than cpu_separated, measured with --bench --types 4,10 on one core:
+// about 130 for 2048x2048, 200 for 1024x1024 and above 270 for 512x512
+const int FFT_BREAK_EVEN_RADIUS = 160;
+
+// convolution through the fast fourier transform on the cpu - O(log n) per pixel for any kernel size
+// convolves with kernel.psf if it is set, otherwise with the gaussian of kernel.weights, edges are clamped
+// the clamped image is cut into overlapping pieces whose transforms are multiplied with the kernel's and added up (overlap-add)
+// the gaussian is separable and runs as 1d transforms of row segments, first of the rows and then of the columns,
+// a kernel image needs 2d transforms of tiles whose rows and columns are transformed in parallel
+void cpu_fft(const unsigned char *src, unsigned char *dst, int width, int height, int channels, const Kernel &kernel, ThreadPool &pool);
+
+#endif
@@ -0,0 +1,242 @@
+#include "cpu_kernels.h"
+
+#include <immintrin.h>
+
+static inline unsigned char toByte(float value)
+{
+    value = value + 0.5f;
+    return value <= 0.0f ? 0 : value >= 255.0f ? 255 : (unsigned char)value;
+}
+
+// scalar kernels, also used for the tails of the vector kernels
+
+static void rowScalar(const float *in, float *out, int count, int step, const float *weights, int taps)
+{
+    for (int x = 0; x < count; ++x)
+    {
+        float sum = 0.0f;
+        for (int i = 0; i < taps; ++i)
+        {
+            sum += weights[i] * in[x + i * step];
+        }
+        out[x] = sum;
+    }
+}
+
+static void columnScalar(const float *const *rows, unsigned char *out, int count, const float *weights, int taps)
+{
+    for (int x = 0; x < count; ++x)
+    {
+        float sum = 0.0f;
+        for (int i = 0; i < taps; ++i)
+        {
+            sum += weights[i] * rows[i][x];
+        }
+        out[x] = toByte(sum);
+    }
+}
+
+// SSE4.1 kernels, 4 values per instruction
+// 4 independent accumulators hide the latency of the adds
+
+__attribute__((target("sse4.1")))
+static void rowSSE(const float *in, float *out, int count, int step, const float *weights, int taps)
+{
+    int x = 0;
+    for (; x + 16 <= count; x += 16)
+    {
+        __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps(), s2 = _mm_setzero_ps(), s3 = _mm_setzero_ps();
+        for (int i = 0; i < taps; ++i)
+        {
+            const float *p = in + x + i * step;
+            __m128 w = _mm_set1_ps(weights[i]);
+            s0 = _mm_add_ps(s0, _mm_mul_ps(w, _mm_loadu_ps(p)));
+            s1 = _mm_add_ps(s1, _mm_mul_ps(w, _mm_loadu_ps(p + 4)));
+            s2 = _mm_add_ps(s2, _mm_mul_ps(w, _mm_loadu_ps(p + 8)));
+            s3 = _mm_add_ps(s3, _mm_mul_ps(w, _mm_loadu_ps(p + 12)));
+        }
+        _mm_storeu_ps(out + x, s0);
+        _mm_storeu_ps(out + x + 4, s1);
+        _mm_storeu_ps(out + x + 8, s2);
+        _mm_storeu_ps(out + x + 12, s3);
+    }
+    for (; x + 4 <= count; x += 4)
+    {
+        __m128 s = _mm_setzero_ps();
+        for (int i = 0; i < taps; ++i)
+        {
+            s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(weights[i]), _mm_loadu_ps(in + x + i * step)));
+        }
+        _mm_storeu_ps(out + x, s);
+    }
+    rowScalar(in + x, out + x, count - x, step, weights, taps);
+}
+
+// rounds 4 sums and stores them as bytes
+__attribute__((target("sse4.1")))
+static inline void storeBytesSSE(unsigned char *out, __m128 sum)
+{
+    __m128i v = _mm_cvttps_epi32(_mm_max_ps(_mm_add_ps(sum, _mm_set1_ps(0.5f)), _mm_setzero_ps()));
+    v = _mm_packus_epi32(v, v);
+    v = _mm_packus_epi16(v, v);
+    *(int*)out = _mm_cvtsi128_si32(v);
+}
+
+__attribute__((target("sse4.1")))
+static void columnSSE(const float *const *rows, unsigned char *out, int count, const float *weights, int taps)
+{
+    int x = 0;
+    for (; x + 16 <= count; x += 16)
+    {
+        __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps(), s2 = _mm_setzero_ps(), s3 = _mm_setzero_ps();
+        for (int i = 0; i < taps; ++i)
+        {
+            const float *p = rows[i] + x;
+            __m128 w = _mm_set1_ps(weights[i]);
+            s0 = _mm_add_ps(s0, _mm_mul_ps(w, _mm_loadu_ps(p)));
+            s1 = _mm_add_ps(s1, _mm_mul_ps(w, _mm_loadu_ps(p + 4)));
+            s2 = _mm_add_ps(s2, _mm_mul_ps(w, _mm_loadu_ps(p + 8)));
+            s3 = _mm_add_ps(s3, _mm_mul_ps(w, _mm_loadu_ps(p + 12)));
+        }
+        storeBytesSSE(out + x, s0);
+        storeBytesSSE(out + x + 4, s1);
+        storeBytesSSE(out + x + 8, s2);
+        storeBytesSSE(out + x + 12, s3);
+    }
+    for (; x + 4 <= count; x += 4)
+    {
+        __m128 s = _mm_setzero_ps();
+        for (int i = 0; i < taps; ++i)
+        {
+            s = _mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(weights[i]), _mm_loadu_ps(rows[i] + x)));
+        }
+        storeBytesSSE(out + x, s);
+    }
+    for (; x < count; ++x)
+    {
+        float sum = 0.0f;
+        for (int i = 0; i < taps; ++i)
+        {
+            sum += weights[i] * rows[i][x];
+        }
+        out[x] = toByte(sum);
+    }
+}
+
+// AVX2 kernels, 8 values per instruction with fused multiply-add
+
+__attribute__((target("avx2,fma")))
+static void rowAVX2(const float *in, float *out, int count, int step, const float *weights, int taps)
+{
+    int x = 0;
+    for (; x + 32 <= count; x += 32)
+    {
+        __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps(), s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+        for (int i = 0; i < taps; ++i)
+        {
+            const float *p = in + x + i * step;
+            __m256 w = _mm256_set1_ps(weights[i]);
+            s0 = _mm256_fmadd_ps(w, _mm256_loadu_ps(p), s0);
+            s1 = _mm256_fmadd_ps(w, _mm256_loadu_ps(p + 8), s1);
+            s2 = _mm256_fmadd_ps(w, _mm256_loadu_ps(p + 16), s2);
+            s3 = _mm256_fmadd_ps(w, _mm256_loadu_ps(p + 24), s3);
+        }
+        _mm256_storeu_ps(out + x, s0);
+        _mm256_storeu_ps(out + x + 8, s1);
+        _mm256_storeu_ps(out + x + 16, s2);
+        _mm256_storeu_ps(out + x + 24, s3);
+    }
+    for (; x + 8 <= count; x += 8)
+    {
+        __m256 s = _mm256_setzero_ps();
+        for (int i = 0; i < taps; ++i)
+        {
+            s = _mm256_fmadd_ps(_mm256_set1_ps(weights[i]), _mm256_loadu_ps(in + x + i * step), s);
+        }
+        _mm256_storeu_ps(out + x, s);
+    }
+    rowScalar(in + x, out + x, count - x, step, weights, taps);
+}
+
+// rounds 8 sums and stores them as bytes
+__attribute__((target("avx2,fma")))
+static inline void storeBytesAVX2(unsigned char *out, __m256 sum)
+{
+    __m256i v = _mm256_cvttps_epi32(_mm256_max_ps(_mm256_add_ps(sum, _mm256_set1_ps(0.5f)), _mm256_setzero_ps()));
+    __m128i w = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    w = _mm_packus_epi16(w, w);
+    _mm_storel_epi64((__m128i*)out, w);
+}
+
+__attribute__((target("avx2,fma")))
+static void columnAVX2(const float *const *rows, unsigned char *out, int count, const float *weights, int taps)
+{
+    int x = 0;
+    for (; x + 32 <= count; x += 32)
+    {
+        __m256 s0 = _mm256_setzero_ps(), s1 = _mm256_setzero_ps(), s2 = _mm256_setzero_ps(), s3 = _mm256_setzero_ps();
+        for (int i = 0; i < taps; ++i)
+        {
+            const float *p = rows[i] + x;
+            __m256 w = _mm256_set1_ps(weights[i]);
+            s0 = _mm256_fmadd_ps(w, _mm256_loadu_ps(p), s0);
+            s1 = _mm256_fmadd_ps(w, _mm256_loadu_ps(p + 8), s1);
+            s2 = _mm256_fmadd_ps(w, _mm256_loadu_ps(p + 16), s2);
+            s3 = _mm256_fmadd_ps(w, _mm256_loadu_ps(p + 24), s3);
+        }
+        storeBytesAVX2(out + x, s0);
+        storeBytesAVX2(out + x + 8, s1);
+        storeBytesAVX2(out + x + 16, s2);
+        storeBytesAVX2(out + x + 24, s3);
+    }
+    for (; x + 8 <= count; x += 8)
+    {
+        __m256 s = _mm256_setzero_ps();
+        for (int i = 0; i < taps; ++i)
+        {
+            s = _mm256_fmadd_ps(_mm256_set1_ps(weights[i]), _mm256_loadu_ps(rows[i] + x), s);
+        }
+        storeBytesAVX2(out + x, s);
+    }
+    for (; x < count; ++x)
+    {
+        float sum = 0.0f;
+        for (int i = 0; i < taps; ++i)
+        {
+            sum += weights[i] * rows[i][x];
+        }
+        out[x] = toByte(sum);
+    }
+}
+
+static CpuKernels detectKernels()
+{
+    __builtin_cpu_init();
+
+    CpuKernels kernels;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        kernels.name = "avx2";
+        kernels.row = rowAVX2;
+        kernels.column = columnAVX2;
+    }
+    else if (__builtin_cpu_supports("sse4.1"))
+    {
+        kernels.name = "sse4.1";
+        kernels.row = rowSSE;
+        kernels.column = columnSSE;
+    }
+    else
+    {
+        kernels.name = "scalar";
+        kernels.row = rowScalar;
+        kernels.column = columnScalar;
+    }
+    return kernels;
+}
+
+const CpuKernels& cpuKernels()
+{
+    static const CpuKernels kernels = detectKernels();
+    return kernels;
+}
@@ -0,0 +1,24 @@
+#ifndef __CPU_KERNELS_H__
+#define __CPU_KERNELS_H__
+
+// convolution kernels used by the cpu implementation
+// every kernel exists as scalar, SSE4.1 and AVX2 code, the fastest one the cpu supports is chosen at startup
+
+// row kernel: out[x] = sum of weights[i] * in[x + i * step] over the taps, for x in [0, count)
+// in must hold count + (taps - 1) * step values
+typedef void (*RowKernel)(const float *in, float *out, int count, int step, const float *weights, int taps);
+
+// column kernel: out[x] = sum of weights[i] * rows[i][x] over the taps, rounded and clamped to 8 bits
+typedef void (*ColumnKernel)(const float *const *rows, unsigned char *out, int count, const float *weights, int taps);
+
+struct CpuKernels
+{
+    const char *name;
+    RowKernel row;
+    ColumnKernel column;
+};
+
+// kernels for the instruction set detected with cpuid
+const CpuKernels& cpuKernels();
+
+#endif
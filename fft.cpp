@@ -0,0 +1,251 @@
+#include "fft.h"
+
+#include <cmath>
+#include <algorithm>
+
+int fftSize(int n)
+{
+    for (int size = std::max(n, 1); ; ++size)
+    {
+        int rest = size;
+        while (rest % 2 == 0) rest /= 2;
+        while (rest % 3 == 0) rest /= 3;
+        while (rest % 5 == 0) rest /= 5;
+        if (rest == 1)
+        {
+            return size;
+        }
+    }
+}
+
+Fft::Fft(int n) : n(n)
+{
+    // radix 4 first, it needs the fewest multiplications per value
+    std::vector<int> radices;
+    int rest = n;
+    while (rest % 4 == 0)
+    {
+        radices.push_back(4);
+        rest /= 4;
+    }
+    for (int p = 2; rest > 1; ++p)
+    {
+        while (rest % p == 0)
+        {
+            radices.push_back(p);
+            rest /= p;
+        }
+    }
+
+    const double pi = std::acos(-1.0);
+    int span = 1;
+    for (size_t i = 0; i < radices.size(); ++i)
+    {
+        Stage stage;
+        stage.radix = radices[i];
+        stage.span = span;
+        stage.twiddles.resize(size_t(span) * stage.radix);
+        for (int k = 0; k < span; ++k)
+        {
+            for (int r = 0; r < stage.radix; ++r)
+            {
+                double angle = -2.0 * pi * r * k / (double(span) * stage.radix);
+                stage.twiddles[k * stage.radix + r] = Complex(float(std::cos(angle)), float(std::sin(angle)));
+            }
+        }
+        if (stage.radix > 5)
+        {
+            for (int m = 0; m < stage.radix; ++m)
+            {
+                double angle = -2.0 * pi * m / stage.radix;
+                stage.roots.push_back(Complex(float(std::cos(angle)), float(std::sin(angle))));
+            }
+        }
+        stages.push_back(stage);
+        span *= stage.radix;
+    }
+}
+
+int Fft::size() const
+{
+    return n;
+}
+
+// v * -i
+static inline Complex minusI(const Complex &v)
+{
+    return Complex(v.imag(), -v.real());
+}
+
+// a stage of radix butterflies, butterfly j = j0 + k combines inputs j + r * stride, multiplied with its twiddles,
+// and writes outputs j0 * radix + k + m * span
+// the butterflies of one radix are separate loops, so the inner loop neither branches on the radix nor divides
+static void radix2(const Complex *in, Complex *out, int stride, int span, const Complex *twiddles)
+{
+    for (int j0 = 0; j0 < stride; j0 += span)
+    {
+        Complex *target = out + j0 * 2;
+        for (int k = 0; k < span; ++k)
+        {
+            const Complex x0 = in[j0 + k];
+            const Complex x1 = multiply(in[j0 + k + stride], twiddles[k * 2 + 1]);
+            target[k] = x0 + x1;
+            target[k + span] = x0 - x1;
+        }
+    }
+}
+
+static void radix3(const Complex *in, Complex *out, int stride, int span, const Complex *twiddles)
+{
+    const float sin60 = 0.86602540378f;
+    for (int j0 = 0; j0 < stride; j0 += span)
+    {
+        Complex *target = out + j0 * 3;
+        for (int k = 0; k < span; ++k)
+        {
+            const Complex *twiddle = twiddles + k * 3;
+            const Complex x0 = in[j0 + k];
+            const Complex x1 = multiply(in[j0 + k + stride], twiddle[1]);
+            const Complex x2 = multiply(in[j0 + k + 2 * stride], twiddle[2]);
+
+            const Complex sum = x1 + x2;
+            const Complex middle = x0 - 0.5f * sum;
+            const Complex turn = minusI(x1 - x2) * sin60;
+            target[k] = x0 + sum;
+            target[k + span] = middle + turn;
+            target[k + 2 * span] = middle - turn;
+        }
+    }
+}
+
+static void radix4(const Complex *in, Complex *out, int stride, int span, const Complex *twiddles)
+{
+    for (int j0 = 0; j0 < stride; j0 += span)
+    {
+        Complex *target = out + j0 * 4;
+        for (int k = 0; k < span; ++k)
+        {
+            const Complex *twiddle = twiddles + k * 4;
+            const Complex x0 = in[j0 + k];
+            const Complex x1 = multiply(in[j0 + k + stride], twiddle[1]);
+            const Complex x2 = multiply(in[j0 + k + 2 * stride], twiddle[2]);
+            const Complex x3 = multiply(in[j0 + k + 3 * stride], twiddle[3]);
+
+            const Complex a = x0 + x2, b = x0 - x2;
+            const Complex c = x1 + x3, d = minusI(x1 - x3);
+            target[k] = a + c;
+            target[k + span] = b + d;
+            target[k + 2 * span] = a - c;
+            target[k + 3 * span] = b - d;
+        }
+    }
+}
+
+static void radix5(const Complex *in, Complex *out, int stride, int span, const Complex *twiddles)
+{
+    // cosines and sines of 2 pi / 5 and 4 pi / 5
+    const float c1 = 0.30901699437f, c2 = -0.80901699437f;
+    const float s1 = 0.95105651630f, s2 = 0.58778525229f;
+    for (int j0 = 0; j0 < stride; j0 += span)
+    {
+        Complex *target = out + j0 * 5;
+        for (int k = 0; k < span; ++k)
+        {
+            const Complex *twiddle = twiddles + k * 5;
+            const Complex x0 = in[j0 + k];
+            const Complex x1 = multiply(in[j0 + k + stride], twiddle[1]);
+            const Complex x2 = multiply(in[j0 + k + 2 * stride], twiddle[2]);
+            const Complex x3 = multiply(in[j0 + k + 3 * stride], twiddle[3]);
+            const Complex x4 = multiply(in[j0 + k + 4 * stride], twiddle[4]);
+
+            const Complex a1 = x1 + x4, b1 = x1 - x4;
+            const Complex a2 = x2 + x3, b2 = x2 - x3;
+            const Complex t1 = x0 + c1 * a1 + c2 * a2;
+            const Complex t2 = x0 + c2 * a1 + c1 * a2;
+            const Complex u1 = minusI(s1 * b1 + s2 * b2);
+            const Complex u2 = minusI(s2 * b1 - s1 * b2);
+            target[k] = x0 + a1 + a2;
+            target[k + span] = t1 + u1;
+            target[k + 2 * span] = t2 + u2;
+            target[k + 3 * span] = t2 - u2;
+            target[k + 4 * span] = t1 - u1;
+        }
+    }
+}
+
+// any other prime, a direct dft of radix values
+static void radixGeneric(const Complex *in, Complex *out, int stride, int span, int radix, const Complex *twiddles, const Complex *roots, Complex *x)
+{
+    for (int j0 = 0; j0 < stride; j0 += span)
+    {
+        Complex *target = out + j0 * radix;
+        for (int k = 0; k < span; ++k)
+        {
+            const Complex *twiddle = twiddles + k * radix;
+            x[0] = in[j0 + k];
+            for (int r = 1; r < radix; ++r)
+            {
+                x[r] = multiply(in[j0 + k + r * stride], twiddle[r]);
+            }
+
+            for (int m = 0; m < radix; ++m)
+            {
+                Complex sum = x[0];
+                for (int r = 1; r < radix; ++r)
+                {
+                    sum += multiply(x[r], roots[(r * m) % radix]);
+                }
+                target[k + m * span] = sum;
+            }
+        }
+    }
+}
+
+void Fft::transform(Complex *data, Complex *scratch, bool inverse) const
+{
+    // the inverse is the conjugate of the forward transform of the conjugate
+    if (inverse)
+    {
+        for (int i = 0; i < n; ++i)
+        {
+            data[i] = std::conj(data[i]);
+        }
+    }
+
+    Complex *in = data;
+    Complex *out = scratch;
+    std::vector<Complex> generic;
+
+    for (size_t s = 0; s < stages.size(); ++s)
+    {
+        const Stage &stage = stages[s];
+        const int stride = n / stage.radix;
+        const Complex *twiddles = stage.twiddles.data();
+
+        switch (stage.radix)
+        {
+            case 2: radix2(in, out, stride, stage.span, twiddles); break;
+            case 3: radix3(in, out, stride, stage.span, twiddles); break;
+            case 4: radix4(in, out, stride, stage.span, twiddles); break;
+            case 5: radix5(in, out, stride, stage.span, twiddles); break;
+            default:
+                generic.resize(stage.radix);
+                radixGeneric(in, out, stride, stage.span, stage.radix, twiddles, stage.roots.data(), generic.data());
+        }
+        std::swap(in, out);
+    }
+
+    // an odd number of stages leaves the result in scratch
+    if (in != data)
+    {
+        std::copy(in, in + n, data);
+    }
+
+    if (inverse)
+    {
+        for (int i = 0; i < n; ++i)
+        {
+            data[i] = std::conj(data[i]);
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef __FFT_H__
+#define __FFT_H__
+
+#include <complex>
+#include <vector>
+
+typedef std::complex<float> Complex;
+
+// product of two complex numbers, std::complex checks for infinities and is much slower without -ffast-math
+inline Complex multiply(const Complex &a, const Complex &b)
+{
+    return Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+}
+
+// smallest length >= n without prime factors other than 2, 3 and 5, the lengths Fft is fast for
+int fftSize(int n);
+
+// complex fast fourier transform of one length, mixed radix 4, 2, 3 and 5 (Stockham autosort, no bit reversal)
+// other prime factors work with a slower generic butterfly
+// the plan is only read by transform, so one Fft can be used by many threads with their own scratch
+class Fft
+{
+    public:
+        explicit Fft(int n);
+
+        int size() const;
+
+        // transforms n values in place, scratch holds at least n values
+        // the inverse is not divided by n
+        void transform(Complex *data, Complex *scratch, bool inverse) const;
+
+    private:
+        struct Stage
+        {
+            int radix;
+            int span; // length of the transforms already combined, the product of the earlier radices
+            std::vector<Complex> twiddles; // e^(-2 pi i r k / (span * radix)) at k * radix + r
+            std::vector<Complex> roots; // e^(-2 pi i m / radix) of the generic butterfly
+        };
+
+        int n;
+        std::vector<Stage> stages;
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include "gpu_timer.h"
+#include "bench.h"
+
+GpuTimer::GpuTimer(int warmup) : active(-1), warmup(warmup)
+{
+}
+
+GpuTimer::~GpuTimer()
+{
+    for (size_t i = 0; i < passes.size(); ++i)
+    {
+        glDeleteQueries(2, passes[i].queries);
+    }
+}
+
+void GpuTimer::begin(const std::string &name)
+{
+    size_t index = 0;
+    while (index < passes.size() && passes[index].name != name)
+    {
+        ++index;
+    }
+
+    if (index == passes.size())
+    {
+        Pass pass;
+        pass.name = name;
+        glGenQueries(2, pass.queries);
+        pass.pending[0] = pass.pending[1] = false;
+        pass.current = 0;
+        pass.dropped = 0;
+        pass.skipped = 0;
+        passes.push_back(pass);
+    }
+
+    Pass &pass = passes[index];
+    pass.current = 1 - pass.current;
+
+    // the gpu is more than one run behind, this run is not timed instead of waiting for it
+    read(pass, pass.current, false);
+    if (pass.pending[pass.current])
+    {
+        ++pass.dropped;
+        active = -1;
+        return;
+    }
+
+    glBeginQuery(GL_TIME_ELAPSED, pass.queries[pass.current]);
+    active = int(index);
+}
+
+void GpuTimer::end()
+{
+    if (active < 0)
+    {
+        return;
+    }
+
+    glEndQuery(GL_TIME_ELAPSED);
+    Pass &pass = passes[active];
+    pass.pending[pass.current] = true;
+    active = -1;
+}
+
+void GpuTimer::read(Pass &pass, int slot, bool wait)
+{
+    if (!pass.pending[slot])
+    {
+        return;
+    }
+
+    GLint available = 0;
+    if (!wait)
+    {
+        glGetQueryObjectiv(pass.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+        {
+            return;
+        }
+    }
+
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(pass.queries[slot], GL_QUERY_RESULT, &elapsed);
+    pass.pending[slot] = false;
+    if (pass.skipped < warmup)
+    {
+        ++pass.skipped;
+        return;
+    }
+    pass.samples.push_back(double(elapsed) / 1.0e6);
+}
+
+void GpuTimer::collect()
+{
+    for (size_t i = 0; i < passes.size(); ++i)
+    {
+        // older query first, so samples stay in order
+        int older = 1 - passes[i].current;
+        read(passes[i], older, false);
+        read(passes[i], passes[i].current, false);
+    }
+}
+
+void GpuTimer::finish()
+{
+    for (size_t i = 0; i < passes.size(); ++i)
+    {
+        int older = 1 - passes[i].current;
+        read(passes[i], older, true);
+        read(passes[i], passes[i].current, true);
+    }
+}
+
+void GpuTimer::report(std::ostream &out)
+{
+    out << "gpu time per pass (ms):" << std::endl;
+    for (size_t i = 0; i < passes.size(); ++i)
+    {
+        if (passes[i].samples.empty())
+        {
+            continue;
+        }
+        Timing timing = summarize(passes[i].samples);
+
+        out << "  " << passes[i].name << ": min " << timing.min
+            << ", median " << timing.median
+            << ", p99 " << timing.p99
+            << " (" << timing.runs << " runs";
+        if (passes[i].dropped > 0)
+        {
+            out << ", " << passes[i].dropped << " not timed";
+        }
+        out << ")" << std::endl;
+    }
+}
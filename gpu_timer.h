@@ -0,0 +1,50 @@
+#ifndef __GPU_TIMER_H__
+#define __GPU_TIMER_H__
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include <GL/glew.h>
+
+// measures the gpu time of named passes with GL_TIME_ELAPSED queries
+// every pass owns two queries used in turns, results are picked up later without stalling
+class GpuTimer
+{
+    public:
+        // the first warmup results of every pass are thrown away (shader compilation, caches)
+        explicit GpuTimer(int warmup = 0);
+        ~GpuTimer();
+
+        // starts timing a pass, passes can not be nested
+        void begin(const std::string &name);
+        void end();
+
+        // reads all results that are already available, never blocks
+        void collect();
+        // waits for the queries still in flight and reads them
+        void finish();
+
+        // prints min, median and p99 of every pass in milliseconds
+        void report(std::ostream &out);
+
+    private:
+        struct Pass
+        {
+            std::string name;
+            GLuint queries[2];
+            bool pending[2];
+            int current;
+            int dropped;
+            int skipped;
+            std::vector<double> samples;
+        };
+
+        std::vector<Pass> passes;
+        int active;
+        int warmup;
+
+        void read(Pass &pass, int slot, bool wait);
+};
+
+#endif
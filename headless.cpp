@@ -0,0 +1,106 @@
+#include "headless.h"
+
+#include <iostream>
+#include <cstring>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLContext context = EGL_NO_CONTEXT;
+
+// prefers the surfaceless platform so that no X server or GBM device is needed
+static EGLDisplay getDisplay()
+{
+    const char *extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (extensions && strstr(extensions, "EGL_MESA_platform_surfaceless"))
+    {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay)
+        {
+            EGLDisplay dpy = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            if (dpy != EGL_NO_DISPLAY)
+            {
+                return dpy;
+            }
+        }
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+bool initializeHeadless(int major, int minor)
+{
+    display = getDisplay();
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+    {
+        std::cerr << "Failed to initialize EGL display." << std::endl;
+        return false;
+    }
+
+    const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+    if (!extensions || !strstr(extensions, "EGL_KHR_surfaceless_context"))
+    {
+        std::cerr << "EGL display does not support surfaceless contexts." << std::endl;
+        return false;
+    }
+
+    // the default surface type is a window, which surfaceless displays do not offer
+    static const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+
+    EGLConfig config;
+    EGLint num_configs = 0;
+    if (!eglChooseConfig(display, config_attribs, &config, 1, &num_configs) || num_configs < 1)
+    {
+        std::cerr << "Failed to choose an EGL config." << std::endl;
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        std::cerr << "Failed to bind the OpenGL API." << std::endl;
+        return false;
+    }
+
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, major,
+        EGL_CONTEXT_MINOR_VERSION, minor,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+    if (context == EGL_NO_CONTEXT)
+    {
+        std::cerr << "Failed to create EGL context." << std::endl;
+        return false;
+    }
+
+    // no surfaces at all, everything is rendered into framebuffer objects
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    {
+        std::cerr << "Failed to make EGL context current." << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+void terminateHeadless()
+{
+    if (display != EGL_NO_DISPLAY)
+    {
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (context != EGL_NO_CONTEXT)
+        {
+            eglDestroyContext(display, context);
+        }
+        eglTerminate(display);
+    }
+    context = EGL_NO_CONTEXT;
+    display = EGL_NO_DISPLAY;
+}
@@ -0,0 +1,11 @@
+#ifndef __HEADLESS_H__
+#define __HEADLESS_H__
+
+// creates an offscreen OpenGL context without any window or display server
+// uses a surfaceless EGL display (Mesa llvmpipe works as well)
+bool initializeHeadless(int major, int minor);
+
+// destroys the offscreen context
+void terminateHeadless();
+
+#endif
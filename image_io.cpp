@@ -0,0 +1,918 @@
+#include "image_io.h"
+#include "png_encoder.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <csetjmp>
+#include <cctype>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+#include <atomic>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <jpeglib.h>
+
+std::string fileExtension(const std::string &name)
+{
+    // a dot in a directory name is not an extension
+    size_t dot = name.find_last_of("./");
+    if (dot == std::string::npos || name[dot] != '.')
+    {
+        return "";
+    }
+    std::string ext = name.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext;
+}
+
+bool jpegFile(const char *fileName)
+{
+    std::string ext = fileExtension(fileName);
+    return ext == "jpg" || ext == "jpeg";
+}
+
+// where libjpeg errors go, the default handler exits the process
+struct JpegError
+{
+    jmp_buf jump;
+    char message[JMSG_LENGTH_MAX];
+};
+
+struct JpegReader::State
+{
+    jpeg_decompress_struct cinfo;
+    jpeg_error_mgr jerr;
+    JpegError error;
+    FILE *file;
+    bool started;
+};
+
+// jumps back into open or read, which then return false
+static void jpegError(j_common_ptr cinfo)
+{
+    JpegError *error = (JpegError*) cinfo->client_data;
+    (*cinfo->err->format_message)(cinfo, error->message);
+    longjmp(error->jump, 1);
+}
+
+JpegReader::JpegReader() : state(NULL)
+{
+}
+
+JpegReader::~JpegReader()
+{
+    close();
+}
+
+void JpegReader::close()
+{
+    if (state && state->started)
+    {
+        jpeg_destroy_decompress(&state->cinfo);
+    }
+    if (state && state->file)
+    {
+        fclose(state->file);
+    }
+    delete state;
+    state = NULL;
+}
+
+bool JpegReader::open(const char *fileName, int scale_denom)
+{
+    close();
+    state = new State();
+    state->file = fopen(fileName, "rb");
+    if (!state->file)
+    {
+        snprintf(state->error.message, sizeof(state->error.message), "can not open file");
+        return false;
+    }
+
+    jpeg_decompress_struct &cinfo = state->cinfo;
+    cinfo.err = jpeg_std_error(&state->jerr);
+    state->jerr.error_exit = jpegError;
+    cinfo.client_data = &state->error;
+    if (setjmp(state->error.jump))
+    {
+        return false;
+    }
+    jpeg_create_decompress(&cinfo);
+    state->started = true;
+
+    jpeg_stdio_src(&cinfo, state->file);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_RGB;
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = scale_denom;
+    jpeg_start_decompress(&cinfo);
+    return true;
+}
+
+int JpegReader::width() const
+{
+    return state->cinfo.output_width;
+}
+
+int JpegReader::height() const
+{
+    return state->cinfo.output_height;
+}
+
+bool JpegReader::read(unsigned char *rows, ptrdiff_t stride, int count)
+{
+    jpeg_decompress_struct &cinfo = state->cinfo;
+    if (setjmp(state->error.jump))
+    {
+        return false;
+    }
+    for (int i = 0; i < count; )
+    {
+        // libjpeg hands out up to rec_outbuf_height rows per call
+        JSAMPROW pointers[4];
+        int batch = std::min(std::min(count - i, 4), std::max(int(cinfo.rec_outbuf_height), 1));
+        for (int k = 0; k < batch; ++k)
+        {
+            pointers[k] = rows + (i + k) * stride;
+        }
+        int decoded = jpeg_read_scanlines(&cinfo, pointers, batch);
+        if (decoded == 0)
+        {
+            snprintf(state->error.message, sizeof(state->error.message), "file ends after %d rows", int(cinfo.output_scanline));
+            return false;
+        }
+        i += decoded;
+    }
+    if (cinfo.output_scanline == cinfo.output_height)
+    {
+        jpeg_finish_decompress(&cinfo);
+    }
+    return true;
+}
+
+const char *JpegReader::error() const
+{
+    return state ? state->error.message : "no file";
+}
+
+int mappedFormat(const char *fileName)
+{
+    std::string ext = fileExtension(fileName);
+    if (ext == "ppm" || ext == "pgm" || ext == "pnm")
+    {
+        return MAPPED_PNM;
+    }
+    if (ext == "pfm")
+    {
+        return MAPPED_PFM;
+    }
+    if (ext == "raw")
+    {
+        return MAPPED_RAW;
+    }
+    return MAPPED_NONE;
+}
+
+// reads the next number of a header, skipping whitespace and comments that run to the end of their line
+static bool headerValue(const unsigned char *data, size_t size, size_t &offset, double &value)
+{
+    while (offset < size && (isspace(data[offset]) || data[offset] == '#'))
+    {
+        if (data[offset] == '#')
+        {
+            while (offset < size && data[offset] != '\n')
+            {
+                ++offset;
+            }
+        }
+        else
+        {
+            ++offset;
+        }
+    }
+    char number[32];
+    size_t length = 0;
+    while (offset < size && length + 1 < sizeof(number) && !isspace(data[offset]))
+    {
+        number[length++] = char(data[offset++]);
+    }
+    number[length] = 0;
+    char *end;
+    value = strtod(number, &end);
+    return length > 0 && *end == 0;
+}
+
+// false for outputs like /dev/stdout or a pipe, which can neither be mapped nor replaced
+static bool regularTarget(const char *fileName)
+{
+    struct stat info;
+    return stat(fileName, &info) != 0 || S_ISREG(info.st_mode);
+}
+
+// creates the file that replaces fileName once it is complete, next to it so it can be renamed over it
+// the input can then be the output too, it is still mapped or read while the result is written
+// targets that are not regular files are opened directly and temporary stays empty
+static int openReplacement(const char *fileName, std::string &target, std::string &temporary)
+{
+    target = fileName;
+    temporary.clear();
+    if (!regularTarget(fileName))
+    {
+        return ::open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+
+    // symbolic links are written through and the mode of an existing file is kept
+    struct stat info;
+    const bool exists = stat(fileName, &info) == 0;
+    char resolved[PATH_MAX];
+    if (exists && realpath(fileName, resolved))
+    {
+        target = resolved;
+    }
+    static std::atomic<unsigned> counter(0);
+    for (int attempt = 0; attempt < 100; ++attempt)
+    {
+        temporary = target + ".tmp" + std::to_string(getpid()) + "." + std::to_string(counter++);
+        int fd = ::open(temporary.c_str(), O_RDWR | O_CREAT | O_EXCL, exists ? info.st_mode & 0777 : 0644);
+        if (fd >= 0)
+        {
+            return fd;
+        }
+        if (errno != EEXIST)
+        {
+            break;
+        }
+    }
+    temporary.clear();
+    return -1;
+}
+
+// renames the replacement over its target if the file is complete, removes it otherwise
+static bool finishReplacement(const std::string &target, const std::string &temporary, bool ok)
+{
+    if (temporary.empty())
+    {
+        return ok;
+    }
+    if (ok && rename(temporary.c_str(), target.c_str()) == 0)
+    {
+        return true;
+    }
+    unlink(temporary.c_str());
+    return false;
+}
+
+static bool writeAll(int fd, const unsigned char *data, size_t size)
+{
+    while (size)
+    {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            return false;
+        }
+        data += written;
+        size -= size_t(written);
+    }
+    return true;
+}
+
+MappedImage::MappedImage() : image_width(0), image_height(0), image_channels(0), format(MAPPED_NONE), swap(false),
+    data(NULL), size(0), pixel_data(NULL), writable(false), in_memory(false), output(-1)
+{
+}
+
+MappedImage::~MappedImage()
+{
+    // an output that was not closed is incomplete, it does not replace the file
+    if (writable)
+    {
+        discard();
+    }
+    close();
+}
+
+bool MappedImage::map(int fd, bool write)
+{
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        message = "can not read file";
+        return false;
+    }
+    size = size_t(info.st_size);
+    void *pointer = mmap(NULL, size, write ? PROT_READ | PROT_WRITE : PROT_READ, write ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    if (pointer == MAP_FAILED)
+    {
+        message = "can not map file";
+        size = 0;
+        return false;
+    }
+    data = (unsigned char*) pointer;
+    writable = write;
+    return true;
+}
+
+bool MappedImage::open(const char *fileName)
+{
+    close();
+    format = mappedFormat(fileName);
+    int fd = ::open(fileName, O_RDONLY);
+    if (fd < 0)
+    {
+        message = "can not open file";
+        return false;
+    }
+    bool mapped = map(fd, false);
+    ::close(fd);
+    if (!mapped)
+    {
+        return false;
+    }
+    // the pixels are mostly read once from top to bottom
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    size_t offset = 2;
+    double values[3] = {0, 0, 0};
+    bool ok = size > 2;
+    const std::string magic = ok ? std::string((const char*) data, 2) : "";
+    if (magic == "P6" || magic == "P5")
+    {
+        format = MAPPED_PNM;
+        image_channels = magic == "P6" ? 3 : 1;
+    }
+    else if (magic == "PF" || magic == "Pf")
+    {
+        format = MAPPED_PFM;
+        image_channels = magic == "PF" ? 3 : 1;
+    }
+    else if (size > 3 && std::string((const char*) data, 3) == "RAW")
+    {
+        format = MAPPED_RAW;
+        offset = 3;
+    }
+    else
+    {
+        message = "not a binary PPM/PGM, PFM or RAW file";
+        close();
+        return false;
+    }
+
+    for (int i = 0; i < 3 && ok; ++i)
+    {
+        ok = headerValue(data, size, offset, values[i]);
+    }
+    // a single whitespace separates the header from the samples
+    ++offset;
+
+    image_width = int(values[0]);
+    image_height = int(values[1]);
+    if (format == MAPPED_PNM && values[2] != 255)
+    {
+        message = "only PPM/PGM files with 8 bits per sample are supported";
+        ok = false;
+    }
+    if (format == MAPPED_PFM)
+    {
+        // the sign of the scale is the byte order, negative is little endian
+        const unsigned short probe = 1;
+        const bool little_endian = *(const unsigned char*) &probe == 1;
+        swap = (values[2] < 0) != little_endian;
+    }
+    if (format == MAPPED_RAW)
+    {
+        image_channels = int(values[2]);
+        if (image_channels != 1 && image_channels != 3)
+        {
+            message = "RAW files have 1 or 3 channels";
+            ok = false;
+        }
+    }
+    if (ok && (image_width < 1 || image_height < 1 || offset + rowBytes() * image_height > size))
+    {
+        message = "file is shorter than its header says";
+        ok = false;
+    }
+    else if (!ok && message.empty())
+    {
+        message = "broken header";
+    }
+    if (!ok)
+    {
+        close();
+        return false;
+    }
+    pixel_data = data + offset;
+    return true;
+}
+
+bool MappedImage::create(const char *fileName, int file_format, int width, int height, int channels)
+{
+    close();
+    format = file_format;
+    image_width = width;
+    image_height = height;
+    image_channels = channels == 1 ? 1 : 3;
+
+    char header[64];
+    if (format == MAPPED_PNM)
+    {
+        snprintf(header, sizeof(header), "%s\n%d %d\n255\n", image_channels == 1 ? "P5" : "P6", width, height);
+    }
+    else if (format == MAPPED_PFM)
+    {
+        const unsigned short probe = 1;
+        const bool little_endian = *(const unsigned char*) &probe == 1;
+        snprintf(header, sizeof(header), "%s\n%d %d\n%s\n", image_channels == 1 ? "Pf" : "PF", width, height, little_endian ? "-1.0" : "1.0");
+    }
+    else
+    {
+        snprintf(header, sizeof(header), "RAW\n%d %d %d\n", width, height, image_channels);
+    }
+    const size_t header_size = strlen(header);
+
+    const size_t file_size = header_size + rowBytes() * height;
+
+    int fd = openReplacement(fileName, target, temporary);
+    if (fd < 0)
+    {
+        message = "can not create file";
+        return false;
+    }
+    if (!temporary.empty() && ftruncate(fd, off_t(file_size)) == 0 && map(fd, true))
+    {
+        ::close(fd);
+    }
+    else
+    {
+        // pipes and devices can not be mapped, the image is kept in memory and written by close
+        data = (unsigned char*) malloc(file_size);
+        if (!data)
+        {
+            message = "out of memory";
+            ::close(fd);
+            finishReplacement(target, temporary, false);
+            return false;
+        }
+        size = file_size;
+        writable = true;
+        in_memory = true;
+        output = fd;
+    }
+    memcpy(data, header, header_size);
+    pixel_data = data + header_size;
+    return true;
+}
+
+bool MappedImage::close()
+{
+    bool ok = true;
+    if (in_memory)
+    {
+        ok = writeAll(output, data, size);
+        ok = ::close(output) == 0 && ok;
+        free(data);
+    }
+    else if (data)
+    {
+        // shared mappings are written back by the kernel, msync only reports errors of that
+        if (writable)
+        {
+            ok = msync(data, size, MS_ASYNC) == 0;
+        }
+        ok = munmap(data, size) == 0 && ok;
+    }
+    if (writable)
+    {
+        ok = finishReplacement(target, temporary, ok);
+    }
+    data = NULL;
+    pixel_data = NULL;
+    size = 0;
+    writable = false;
+    in_memory = false;
+    output = -1;
+    temporary.clear();
+    return ok;
+}
+
+void MappedImage::discard()
+{
+    if (!writable)
+    {
+        return;
+    }
+    if (in_memory)
+    {
+        ::close(output);
+        free(data);
+    }
+    else
+    {
+        munmap(data, size);
+    }
+    finishReplacement(target, temporary, false);
+    data = NULL;
+    pixel_data = NULL;
+    size = 0;
+    writable = false;
+    in_memory = false;
+    output = -1;
+    temporary.clear();
+}
+
+int MappedImage::width() const
+{
+    return image_width;
+}
+
+int MappedImage::height() const
+{
+    return image_height;
+}
+
+int MappedImage::channels() const
+{
+    return image_channels;
+}
+
+bool MappedImage::rgb8() const
+{
+    return format != MAPPED_PFM && image_channels == 3;
+}
+
+bool MappedImage::topDown() const
+{
+    return format == MAPPED_PNM;
+}
+
+unsigned char *MappedImage::pixels() const
+{
+    return pixel_data;
+}
+
+size_t MappedImage::rowBytes() const
+{
+    return size_t(image_width) * image_channels * (format == MAPPED_PFM ? sizeof(float) : 1);
+}
+
+const char *MappedImage::error() const
+{
+    return message.c_str();
+}
+
+void MappedImage::readRow(int y, unsigned char *rgb) const
+{
+    const unsigned char *row = pixel_data + rowBytes() * (topDown() ? y : image_height - 1 - y);
+    const int samples = image_width * image_channels;
+    for (int i = 0; i < samples; ++i)
+    {
+        unsigned char value;
+        if (format == MAPPED_PFM)
+        {
+            unsigned char bytes[4];
+            memcpy(bytes, row + i * 4, 4);
+            if (swap)
+            {
+                std::swap(bytes[0], bytes[3]);
+                std::swap(bytes[1], bytes[2]);
+            }
+            float sample;
+            memcpy(&sample, bytes, 4);
+            value = (unsigned char) (std::min(std::max(sample, 0.0f), 1.0f) * 255.0f + 0.5f);
+        }
+        else
+        {
+            value = row[i];
+        }
+
+        if (image_channels == 3)
+        {
+            rgb[i] = value;
+        }
+        else
+        {
+            rgb[i * 3] = rgb[i * 3 + 1] = rgb[i * 3 + 2] = value;
+        }
+    }
+}
+
+void MappedImage::writeRow(int y, const unsigned char *row, int channels)
+{
+    unsigned char *target = pixel_data + rowBytes() * (topDown() ? y : image_height - 1 - y);
+    for (int x = 0; x < image_width; ++x)
+    {
+        for (int c = 0; c < image_channels; ++c)
+        {
+            const unsigned char value = row[x * channels + c];
+            if (format == MAPPED_PFM)
+            {
+                const float sample = value / 255.0f;
+                memcpy(target + (x * image_channels + c) * 4, &sample, 4);
+            }
+            else
+            {
+                target[x * image_channels + c] = value;
+            }
+        }
+    }
+}
+
+RowReader::RowReader() : jpeg(false), row(0)
+{
+}
+
+bool RowReader::open(const char *fileName, int scale_denom)
+{
+    jpeg = jpegFile(fileName);
+    row = 0;
+    if (jpeg)
+    {
+        return jpeg_reader.open(fileName, scale_denom);
+    }
+    if (scale_denom != 1)
+    {
+        message = "only JPEG files can be read at a reduced size";
+        return false;
+    }
+    if (!mapped.open(fileName))
+    {
+        message = mapped.error();
+        return false;
+    }
+    return true;
+}
+
+int RowReader::width() const
+{
+    return jpeg ? jpeg_reader.width() : mapped.width();
+}
+
+int RowReader::height() const
+{
+    return jpeg ? jpeg_reader.height() : mapped.height();
+}
+
+bool RowReader::read(unsigned char *rows, ptrdiff_t stride, int count)
+{
+    if (jpeg)
+    {
+        return jpeg_reader.read(rows, stride, count);
+    }
+    if (row + count > mapped.height())
+    {
+        message = "read past the last row";
+        return false;
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        mapped.readRow(row++, rows + i * stride);
+    }
+    return true;
+}
+
+const char *RowReader::error() const
+{
+    return jpeg ? jpeg_reader.error() : message.c_str();
+}
+
+struct RowWriter::State
+{
+    int width, height, channels;
+    int written;
+    bool ok;
+
+    // JPEG goes through libjpeg and PNG through PngEncoder to stdio, everything else into a mapped file
+    // but PPM to a pipe or device, which is written to stdio a row at a time
+    bool jpeg, png, pnm_rows;
+    FILE *file;
+    std::string target, temporary; // see openReplacement
+    std::vector<unsigned char> row;
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr jerr;
+    JpegError error;
+    bool started;
+    PngEncoder png_encoder;
+    MappedImage mapped;
+};
+
+RowWriter::RowWriter() : state(NULL)
+{
+}
+
+RowWriter::~RowWriter()
+{
+    close();
+}
+
+bool RowWriter::open(const char *fileName, int width, int height, int channels, const EncodeOptions &encode)
+{
+    close();
+    state = new State();
+    state->width = width;
+    state->height = height;
+    state->channels = channels;
+    state->written = 0;
+    state->ok = true;
+    state->jpeg = jpegFile(fileName);
+    state->png = fileExtension(fileName) == "png";
+
+    if (!state->jpeg && !state->png)
+    {
+        // names without a known extension are written as PPM
+        const int format = mappedFormat(fileName) == MAPPED_NONE ? MAPPED_PNM : mappedFormat(fileName);
+        state->pnm_rows = format == MAPPED_PNM && !regularTarget(fileName);
+        if (!state->pnm_rows)
+        {
+            state->ok = state->mapped.create(fileName, format, width, height, channels);
+            return state->ok;
+        }
+    }
+
+    int fd = openReplacement(fileName, state->target, state->temporary);
+    state->file = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (!state->file)
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        finishReplacement(state->target, state->temporary, false);
+        state->ok = false;
+        return false;
+    }
+    if (state->pnm_rows)
+    {
+        state->ok = fprintf(state->file, "%s\n%d %d\n255\n", channels == 1 ? "P5" : "P6", width, height) > 0;
+        return state->ok;
+    }
+    if (state->png)
+    {
+        state->ok = state->png_encoder.start(state->file, width, height, std::min(channels, 4), encode.compression, encode.pool);
+        return state->ok;
+    }
+
+    // a write error (e.g. a full disk) jumps back here, into write or into close, like in JpegReader
+    jpeg_compress_struct &cinfo = state->cinfo;
+    cinfo.err = jpeg_std_error(&state->jerr);
+    state->jerr.error_exit = jpegError;
+    cinfo.client_data = &state->error;
+    if (setjmp(state->error.jump))
+    {
+        state->ok = false;
+        return false;
+    }
+    jpeg_create_compress(&cinfo);
+    state->started = true;
+    jpeg_stdio_dest(&cinfo, state->file);
+
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = channels;
+    cinfo.in_color_space = channels == 1 ? JCS_GRAYSCALE : JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, encode.quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    return true;
+}
+
+bool RowWriter::write(const unsigned char *rows, ptrdiff_t stride, int count)
+{
+    State &s = *state;
+    count = std::min(count, s.height - s.written);
+    if (s.png)
+    {
+        s.ok = s.ok && s.png_encoder.write(rows, stride, count);
+        s.written += count;
+        return s.ok;
+    }
+    if (s.jpeg)
+    {
+        if (setjmp(s.error.jump))
+        {
+            s.ok = false;
+            return false;
+        }
+    }
+    for (int i = 0; i < count && s.ok; ++i)
+    {
+        const unsigned char *src = rows + i * stride;
+        if (s.jpeg)
+        {
+            JSAMPROW pointers[1] = { const_cast<JSAMPROW>(src) };
+            jpeg_write_scanlines(&s.cinfo, pointers, 1);
+        }
+        else if (s.pnm_rows)
+        {
+            // 1 or 3 channels are stored, like in the mapped file
+            const int stored = s.channels == 1 ? 1 : 3;
+            s.row.resize(size_t(s.width) * stored);
+            for (int x = 0; x < s.width; ++x)
+            {
+                for (int c = 0; c < stored; ++c)
+                {
+                    s.row[x * stored + c] = src[x * s.channels + c];
+                }
+            }
+            s.ok = fwrite(s.row.data(), 1, s.row.size(), s.file) == s.row.size();
+        }
+        else
+        {
+            s.mapped.writeRow(s.written + i, src, s.channels);
+        }
+    }
+    s.written += count;
+    return s.ok;
+}
+
+// writes the end of the JPEG data, false if libjpeg failed at that
+static bool finishJpeg(jpeg_compress_struct &cinfo, JpegError &error)
+{
+    if (setjmp(error.jump))
+    {
+        return false;
+    }
+    jpeg_finish_compress(&cinfo);
+    return true;
+}
+
+bool RowWriter::close()
+{
+    if (!state)
+    {
+        return false;
+    }
+    bool ok = state->ok && state->written == state->height;
+    if (state->png && state->file)
+    {
+        ok = state->png_encoder.finish() && ok;
+        ok = fclose(state->file) == 0 && ok;
+    }
+    else if (state->jpeg && state->file)
+    {
+        if (ok && state->started)
+        {
+            ok = finishJpeg(state->cinfo, state->error);
+        }
+        if (state->started)
+        {
+            jpeg_destroy_compress(&state->cinfo);
+        }
+        ok = fclose(state->file) == 0 && ok;
+    }
+    else if (state->pnm_rows && state->file)
+    {
+        ok = fclose(state->file) == 0 && ok;
+    }
+    else if (!state->jpeg && !state->png && !state->pnm_rows)
+    {
+        // an incomplete image does not replace the file
+        if (ok)
+        {
+            ok = state->mapped.close();
+        }
+        else
+        {
+            state->mapped.discard();
+        }
+    }
+    if (state->file)
+    {
+        ok = finishReplacement(state->target, state->temporary, ok);
+    }
+    delete state;
+    state = NULL;
+    return ok;
+}
+
+bool writeImage(const char *fileName, const unsigned char *data, int width, int height, int channels, bool flip, const EncodeOptions &encode)
+{
+    const ptrdiff_t stride = ptrdiff_t(width) * channels;
+    RowWriter writer;
+    bool ok = writer.open(fileName, width, height, channels, encode);
+    if (ok)
+    {
+        // bottom-up rows are written from the last one with a negative stride
+        ok = writer.write(flip ? data + (height - 1) * stride : data, flip ? -stride : stride, height);
+        ok = writer.close() && ok;
+    }
+
+    if (!ok)
+    {
+        std::cerr << "Failed to write output image: " << fileName << std::endl;
+    }
+    return ok;
+}
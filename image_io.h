@@ -0,0 +1,191 @@
+#ifndef __IMAGE_IO_H__
+#define __IMAGE_IO_H__
+
+#include <cstddef>
+#include <string>
+
+#include "thread_pool.h"
+
+// settings of the encoders
+struct EncodeOptions
+{
+    int quality; // JPEG quality 1-100
+    int compression; // PNG deflate level 0-9
+    ThreadPool *pool; // PNG chunks are filtered and deflated on it, NULL encodes on the calling thread
+
+    EncodeOptions() : quality(95), compression(6), pool(NULL) {}
+};
+
+// writes an interleaved 8-bit image to disk
+// format is chosen from the extension: .jpg/.jpeg uses libjpeg, .png is deflated in parallel chunks,
+// .pfm and .raw are the mapped formats and anything else is written as binary PPM
+// if flip is true rows are written bottom-up (OpenGL readback order)
+bool writeImage(const char *fileName, const unsigned char *data, int width, int height, int channels, bool flip,
+                const EncodeOptions &encode = EncodeOptions());
+
+// lower case extension of a file name without the dot, empty if it has none
+std::string fileExtension(const std::string &name);
+
+// true for the .jpg/.jpeg files JpegReader is used for
+bool jpegFile(const char *fileName);
+
+// decodes a JPEG file a few scanlines at a time, so the rows can go straight to where they are needed
+// instead of through a whole decoded copy of the image
+// with scale_denom 2, 4 or 8 libjpeg scales in the DCT domain and skips most of the inverse transform
+class JpegReader
+{
+    public:
+        JpegReader();
+        ~JpegReader();
+
+        // reads the header, false (with error() set) if the file can not be opened or decoded
+        bool open(const char *fileName, int scale_denom = 1);
+
+        // size of the decoded, possibly downscaled, image
+        int width() const;
+        int height() const;
+
+        // decodes the next count rows as 8-bit RGB into rows, stride bytes apart
+        // a negative stride with rows pointing at the last row stores them bottom-up
+        // returns false (with error() set) if the data is corrupt
+        bool read(unsigned char *rows, ptrdiff_t stride, int count);
+
+        const char *error() const;
+
+    private:
+        struct State; // keeps jpeglib.h out of the header
+        State *state;
+
+        void close();
+
+        JpegReader(const JpegReader&);
+        JpegReader &operator=(const JpegReader&);
+};
+
+// uncompressed formats that are mapped into memory instead of read, so their pixels can be used in place
+enum MappedFormat
+{
+    MAPPED_NONE,
+    MAPPED_PNM, // binary PPM (P6) or PGM (P5) with 8 bits, rows top-down
+    MAPPED_PFM, // PFM (PF or Pf) with 32-bit floats in [0, 1], rows bottom-up
+    MAPPED_RAW  // "RAW\n<width> <height> <channels>\n" and 8-bit samples with rows bottom-up, the order OpenGL uses
+};
+
+// format of the extension of a file name: .ppm/.pgm/.pnm, .pfm or .raw
+int mappedFormat(const char *fileName);
+
+// an uncompressed image file mapped into memory
+// 8-bit RGB files can be uploaded or blurred straight from the mapping, and written by blurring or reading back into one
+class MappedImage
+{
+    public:
+        MappedImage();
+        ~MappedImage();
+
+        // maps an existing file for reading, the format is taken from its header
+        bool open(const char *fileName);
+
+        // creates a file for width x height pixels and maps it for writing, 1 or 3 channels are stored
+        // the file replaces fileName in close, so fileName can still be mapped as the input meanwhile;
+        // outputs that can not be mapped, like pipes, are kept in memory and written in close
+        bool create(const char *fileName, int format, int width, int height, int channels);
+
+        // unmaps the file, false if writing it back failed
+        bool close();
+
+        // drops an output without touching fileName, e.g. after an error
+        void discard();
+
+        int width() const;
+        int height() const;
+        int channels() const;
+
+        // samples are 8-bit RGB, the layout the blurs and the upload ring use
+        bool rgb8() const;
+        // row order of the file, PPM/PGM are top-down and PFM and RAW bottom-up
+        bool topDown() const;
+        // the rows in file order
+        unsigned char *pixels() const;
+        size_t rowBytes() const;
+
+        // converts row y, counted from the top, to 8-bit RGB
+        void readRow(int y, unsigned char *rgb) const;
+        // stores a row of 8-bit samples with channels per pixel as row y, counted from the top
+        void writeRow(int y, const unsigned char *row, int channels);
+
+        const char *error() const;
+
+    private:
+        int image_width, image_height, image_channels;
+        int format;
+        bool swap; // PFM samples in the other byte order
+        unsigned char *data;
+        size_t size;
+        unsigned char *pixel_data;
+        bool writable;
+        bool in_memory; // output that could not be mapped, written to output in close
+        int output;
+        std::string target, temporary; // the output file and the one replacing it
+        std::string message;
+
+        bool map(int fd, bool write);
+
+        MappedImage(const MappedImage&);
+        MappedImage &operator=(const MappedImage&);
+};
+
+// reads JPEG files and the mapped formats a few rows at a time, top-down as 8-bit RGB
+// only the rows being read are in memory, for images that do not fit into it as a whole
+class RowReader
+{
+    public:
+        RowReader();
+
+        // scale_denom is passed on to JpegReader, other formats can not be reduced
+        bool open(const char *fileName, int scale_denom = 1);
+
+        int width() const;
+        int height() const;
+
+        // see JpegReader::read
+        bool read(unsigned char *rows, ptrdiff_t stride, int count);
+
+        const char *error() const;
+
+    private:
+        bool jpeg;
+        JpegReader jpeg_reader;
+        MappedImage mapped;
+        int row; // next row of the mapped file
+        std::string message;
+
+        RowReader(const RowReader&);
+        RowReader &operator=(const RowReader&);
+};
+
+// writes an image a few rows at a time, top-down, in the format writeImage chooses for the file name
+// PPM, PFM and RAW go into a mapped file, PPM to a pipe or device is written a row at a time
+// the output replaces the file only when close succeeds, so it can be written over the input
+class RowWriter
+{
+    public:
+        RowWriter();
+        ~RowWriter();
+
+        bool open(const char *fileName, int width, int height, int channels, const EncodeOptions &encode = EncodeOptions());
+
+        // writes the next count rows, stride bytes apart
+        bool write(const unsigned char *rows, ptrdiff_t stride, int count);
+
+        // finishes the file, false if a write failed or rows are missing
+        bool close();
+
+    private:
+        struct State; // keeps jpeglib.h and zlib.h out of the header
+        State *state;
+
+        RowWriter(const RowWriter&);
+        RowWriter &operator=(const RowWriter&);
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include "kernel.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+int gaussianRadius(float sigma)
+{
+    return std::max(1, int(std::ceil(3.0f * sigma)));
+}
+
+std::vector<double> exactWeights(float sigma, int radius)
+{
+    // area of the gaussian over [i - 0.5, i + 0.5]
+    const double scale = 1.0 / (std::sqrt(2.0) * sigma);
+    std::vector<double> area(radius + 1);
+    double sum = 0.0;
+    for (int i = 0; i <= radius; ++i)
+    {
+        area[i] = 0.5 * (std::erf((i + 0.5) * scale) - std::erf((i - 0.5) * scale));
+        sum += i == 0 ? area[i] : 2.0 * area[i];
+    }
+
+    for (int i = 0; i <= radius; ++i)
+    {
+        area[i] /= sum;
+    }
+    return area;
+}
+
+Kernel createKernel(float sigma, int radius, int boxes)
+{
+    Kernel kernel;
+    kernel.sigma = sigma;
+    kernel.radius = radius > 0 ? radius : gaussianRadius(sigma);
+
+    std::vector<double> exact = exactWeights(sigma, kernel.radius);
+    kernel.weights.assign(exact.begin(), exact.end());
+
+    // a fetch at i + t with t = w1 / (w0 + w1) returns (w0 * p[i] + w1 * p[i + 1]) / (w0 + w1)
+    kernel.linear_offsets.push_back(0.0f);
+    kernel.linear_weights.push_back(kernel.weights[0]);
+    for (int i = 1; i <= kernel.radius; i += 2)
+    {
+        double w0 = exact[i];
+        double w1 = i < kernel.radius ? exact[i + 1] : 0.0;
+        kernel.linear_offsets.push_back(float(i + w1 / (w0 + w1)));
+        kernel.linear_weights.push_back(float(w0 + w1));
+    }
+
+    kernel.box_radii = boxRadii(sigma, boxes);
+    kernel.pyramid_levels = pyramidLevels(sigma);
+    kernel.pyramid_sigma = pyramidSigma(sigma, kernel.pyramid_levels);
+    kernel.psf_width = 0;
+    kernel.psf_height = 0;
+    return kernel;
+}
+
+std::vector<int> boxRadii(float sigma, int boxes)
+{
+    // a box of odd width w has variance (w^2 - 1) / 12, the variances of successive boxes add up
+    const double variance = double(sigma) * sigma;
+    int lower = int(std::floor(std::sqrt(12.0 * variance / boxes + 1.0)));
+    if (lower % 2 == 0)
+    {
+        --lower;
+    }
+    const int upper = lower + 2;
+
+    // number of boxes with the lower width so that the sum is closest to the variance
+    int count = int(std::floor((12.0 * variance - boxes * lower * lower - 4.0 * boxes * lower - 3.0 * boxes) / (-4.0 * lower - 4.0) + 0.5));
+    count = std::min(std::max(count, 0), boxes);
+
+    std::vector<int> radii(boxes);
+    for (int i = 0; i < boxes; ++i)
+    {
+        radii[i] = ((i < count ? lower : upper) - 1) / 2;
+    }
+    return radii;
+}
+
+float pyramidSigma(float sigma, int levels)
+{
+    // downsampling k averages two texels 2^(k-1) pixels apart and adds 4^(k-1) / 4,
+    // upsampling k weights texels 2^k pixels apart with 3/4 and 1/4 and adds 3 * 4^k / 16, together (4^levels - 1) / 3
+    // weights integrated over a pixel add 1 / 12 of their texel on both sides
+    const double scale = std::ldexp(1.0, 2 * levels);
+    const double variance = double(sigma) * sigma + 1.0 / 12.0 - (scale - 1.0) / 3.0;
+    return float(std::sqrt(std::max(variance / scale - 1.0 / 12.0, 0.0)));
+}
+
+int pyramidLevels(float sigma)
+{
+    int levels = 0;
+    while (pyramidSigma(sigma, levels + 1) >= PYRAMID_MIN_SIGMA)
+    {
+        ++levels;
+    }
+    return levels;
+}
+
+bool setPsf(Kernel &kernel, const unsigned char *pixels, int width, int height)
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < size_t(width) * height; ++i)
+    {
+        sum += pixels[i];
+    }
+    if (sum == 0.0)
+    {
+        return false;
+    }
+
+    kernel.psf.resize(size_t(width) * height);
+    for (size_t i = 0; i < kernel.psf.size(); ++i)
+    {
+        kernel.psf[i] = float(pixels[i] / sum);
+    }
+    kernel.psf_width = width;
+    kernel.psf_height = height;
+    return true;
+}
+
+std::vector<float> fullWeights(const Kernel &kernel)
+{
+    std::vector<float> weights(2 * kernel.radius + 1);
+    for (int i = -kernel.radius; i <= kernel.radius; ++i)
+    {
+        weights[i + kernel.radius] = kernel.weights[std::abs(i)];
+    }
+    return weights;
+}
@@ -0,0 +1,77 @@
+#ifndef __KERNEL_H__
+#define __KERNEL_H__
+
+#include <vector>
+
+// blur strength of the original shader tables
+const float DEFAULT_SIGMA = 10.0f;
+const int DEFAULT_RADIUS = 16;
+
+// largest radius the shaders accept, size of their weight arrays minus one
+const int MAX_RADIUS = 128;
+
+// taps of the bilinear shader for MAX_RADIUS, neighbouring taps are merged in pairs
+const int MAX_LINEAR_TAPS = MAX_RADIUS / 2 + 1;
+
+// successive box blurs approximating the gaussian, 3 is within a few percent and more get closer
+const int DEFAULT_BOXES = 3;
+
+// smallest sigma the pyramid blurs its coarsest level with, smaller ones show the resampling
+const float PYRAMID_MIN_SIGMA = 2.0f;
+
+// one half of a symmetric gaussian kernel with 2 * radius + 1 taps
+struct Kernel
+{
+    float sigma;
+    int radius;
+    // weights[0] is the center tap, weights[i] is used for offsets -i and +i
+    std::vector<float> weights;
+
+    // taps i and i + 1 merged into one bilinear fetch between them
+    // linear_offsets[0] = 0 is the center tap, the others are used at -offset and +offset
+    std::vector<float> linear_offsets;
+    std::vector<float> linear_weights;
+
+    // radii of the box blurs whose succession has about the same variance as the gaussian
+    std::vector<int> box_radii;
+
+    // halvings of the pyramid and the sigma of the gaussian on its coarsest level, in coarse texels
+    int pyramid_levels;
+    float pyramid_sigma;
+
+    // arbitrary kernel (point spread function) the fft implementation uses instead of the gaussian, empty for the gaussian
+    // psf_width x psf_height weights row by row that sum to one, centered on psf_width / 2, psf_height / 2
+    std::vector<float> psf;
+    int psf_width, psf_height;
+};
+
+// radius that covers +-3 sigma
+int gaussianRadius(float sigma);
+
+// computes normalized weights and the merged bilinear taps on the cpu, a radius <= 0 is derived from sigma
+// every weight integrates the gaussian over its pixel, so sigma = 10 and radius = 16
+// reproduces the tables the shaders used to hard-code
+Kernel createKernel(float sigma, int radius, int boxes = DEFAULT_BOXES);
+
+// the normalized half kernel in double precision, used by createKernel and the reference blur
+std::vector<double> exactWeights(float sigma, int radius);
+
+// radii of boxes box blurs with a total variance as close to sigma^2 as odd widths allow
+// the widths differ by at most two (P. Kovesi, "Fast Almost-Gaussian Filtering")
+std::vector<int> boxRadii(float sigma, int boxes);
+
+// number of 2x2 downsamplings before the coarse gaussian still has PYRAMID_MIN_SIGMA
+int pyramidLevels(float sigma);
+
+// sigma of the coarse gaussian so that downsampling, blur and bilinear upsampling together have the variance of sigma
+// every halving adds the variance of a 2x2 box and every doubling that of a bilinear fetch
+float pyramidSigma(float sigma, int levels);
+
+// makes a grayscale image the kernel, normalized to a sum of one
+// returns false if the image is black
+bool setPsf(Kernel &kernel, const unsigned char *pixels, int width, int height);
+
+// all 2 * radius + 1 weights from offset -radius to +radius
+std::vector<float> fullWeights(const Kernel &kernel);
+
+#endif
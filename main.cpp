@@ -1,7 +1,27 @@
 #include <iostream>
 #include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <stb_image.h>
 #include <shader.h>
+#include <headless.h>
+#include <image_io.h>
+#include <cpu_blur.h>
+#include <cpu_kernels.h>
+#include <kernel.h>
+#include <gpu_timer.h>
+#include <pixel_buffers.h>
+#include <bench.h>
+#include <reference.h>
+#include <batch.h>
+#include <video.h>
+#include <bounded_queue.h>
+#include <tiles.h>
 
 #define GLEW_STATIC
 #include <GL/glew.h>
@@ -16,6 +36,59 @@ int window_width = 1024;
 int window_height = 768;
 int texture_width, texture_height;
 
+// state of the interactive viewer, the blur is only recomputed when one of these changes
+int blur_type;
+float blur_sigma;
+bool reload_input = false;
+bool result_dirty = true;
+bool save_result = false;
+
+// times every blur pass on the gpu when --timing is given
+GpuTimer *gpu_timer = NULL;
+
+// implementations of the command line, the index is the type
+struct Implementation
+{
+    const char *name;
+    bool gpu; // runs in the OpenGL pipeline, otherwise on the cpu
+    bool weights; // uses the kernel weights in a shader, so the radius is limited to MAX_RADIUS
+};
+
+static const Implementation implementations[] = {
+    { "unknown", false, false },
+    { "naive", true, true },
+    { "separated", true, true },
+    { "separated_bilinear", true, true },
+    { "cpu_separated", false, false },
+    { "compute", true, true },
+    { "cpu_box", false, false },
+    { "box", true, false },
+    { "cpu_iir", false, false },
+    { "pyramid", true, false },
+    { "cpu_fft", false, false },
+};
+static const int IMPLEMENTATION_COUNT = sizeof(implementations) / sizeof(implementations[0]) - 1;
+
+static bool validType(int type)
+{
+    return type >= 1 && type <= IMPLEMENTATION_COUNT;
+}
+
+static bool gpuType(int type)
+{
+    return validType(type) && implementations[type].gpu;
+}
+
+static bool radiusLimited(int type)
+{
+    return validType(type) && implementations[type].weights;
+}
+
+static const char *implementationName(int type)
+{
+    return implementations[validType(type) ? type : 0].name;
+}
+
 void errorCallback(int error, const char* description)
 {
     fprintf(stderr, "Error(%d): %s\n", error, description);
@@ -27,6 +100,38 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
     {
         glfwSetWindowShouldClose(window, GLFW_TRUE);
     }
+    // number keys switch the implementation, 0 is the tenth
+    else if (key >= GLFW_KEY_1 && key <= GLFW_KEY_9 && key < GLFW_KEY_1 + IMPLEMENTATION_COUNT && action == GLFW_PRESS)
+    {
+        blur_type = key - GLFW_KEY_1 + 1;
+        result_dirty = true;
+    }
+    else if (key == GLFW_KEY_0 && IMPLEMENTATION_COUNT >= 10 && action == GLFW_PRESS)
+    {
+        blur_type = 10;
+        result_dirty = true;
+    }
+    // up and down change sigma, radius has to stay in the range of the shaders
+    else if ((key == GLFW_KEY_UP || key == GLFW_KEY_DOWN) && (action == GLFW_PRESS || action == GLFW_REPEAT))
+    {
+        float sigma = blur_sigma + (key == GLFW_KEY_UP ? 1.0f : -1.0f);
+        if (sigma >= 1.0f && gaussianRadius(sigma) <= MAX_RADIUS)
+        {
+            blur_sigma = sigma;
+            result_dirty = true;
+        }
+    }
+    // R reads the input image again
+    else if (key == GLFW_KEY_R && action == GLFW_PRESS)
+    {
+        reload_input = true;
+        result_dirty = true;
+    }
+    // S writes the shown result to --output
+    else if (key == GLFW_KEY_S && action == GLFW_PRESS)
+    {
+        save_result = true;
+    }
 }
 
 void window_size_callback(GLFWwindow* window, int width, int height)
@@ -78,148 +183,506 @@ void initialize(int width, int height, const char *windowName)
     glfwSetKeyCallback(win, keyCallback);
 }
 
+// initializations for offscreen rendering, no window is created
+void initializeHeadless()
+{
+    if (!initializeHeadless(3, 3))
+    {
+        std::cerr << "Failed to create headless OpenGL context." << std::endl;
+        exit(-1);
+    }
+
+    glewExperimental = true;
+
+    // GLEW built against GLX reports a missing display even though the EGL context is usable
+    GLenum err = glewInit();
+    if (err != GLEW_OK && err != GLEW_ERROR_NO_GLX_DISPLAY)
+    {
+        std::cerr << "GLEW initialization failed.\n" << std::endl;
+        exit(-1);
+    }
+}
+
 Shader loadShaders(const char *vertexShaderName, const char *fragmentShaderName)
 {
     Shader ourShader = Shader(vertexShaderName, fragmentShaderName);
     return ourShader;
 }
 
-// reads and loads texture
-void loadTexture(const char *fileName, GLuint& texture, int& width, int& height, const int type )
+// averages blocks of reduce x reduce pixels of a bottom-up image in place
+// blocks start at the top row and the rightmost and bottom ones may be partial, like the DCT scaling of libjpeg
+static void reduceImage(unsigned char *data, int &width, int &height, int reduce)
+{
+    const int reduced_width = (width + reduce - 1) / reduce;
+    const int reduced_height = (height + reduce - 1) / reduce;
+    std::vector<int> sums(size_t(reduced_width) * 3);
+    for (int y = reduced_height - 1; y >= 0; --y)
+    {
+        // rows of the block counted from the top of the image
+        const int top = (reduced_height - 1 - y) * reduce;
+        const int rows = std::min(reduce, height - top);
+        std::fill(sums.begin(), sums.end(), 0);
+        for (int r = 0; r < rows; ++r)
+        {
+            const unsigned char *row = data + size_t(height - 1 - top - r) * width * 3;
+            for (int x = 0; x < width; ++x)
+            {
+                for (int c = 0; c < 3; ++c)
+                {
+                    sums[(x / reduce) * 3 + c] += row[x * 3 + c];
+                }
+            }
+        }
+        // the reduced rows never overtake the rows still to be read
+        unsigned char *out = data + size_t(y) * reduced_width * 3;
+        for (int x = 0; x < reduced_width; ++x)
+        {
+            const int count = rows * std::min(reduce, width - x * reduce);
+            for (int c = 0; c < 3; ++c)
+            {
+                out[x * 3 + c] = (unsigned char) ((sums[x * 3 + c] + count / 2) / count);
+            }
+        }
+    }
+    width = reduced_width;
+    height = reduced_height;
+}
+
+// reads an image as 8-bit RGB, reduced to 1/reduce of its size
+// rows are flipped to match the bottom-up order of OpenGL, stbi_set_flip_vertically_on_load has to be set
+// JPEG files are decoded scanline by scanline with libjpeg, which also does the reduction,
+// PPM/PGM, PFM and RAW files are mapped and converted row by row
+// returns NULL and sets error when the file can not be read, the pixels are freed with free
+unsigned char* readImage(const char *fileName, int& width, int& height, int reduce, std::string &error)
+{
+    if (mappedFormat(fileName) != MAPPED_NONE)
+    {
+        MappedImage mapped;
+        if (!mapped.open(fileName))
+        {
+            error = mapped.error();
+            return NULL;
+        }
+        width = mapped.width();
+        height = mapped.height();
+        unsigned char *data = (unsigned char*) malloc(size_t(width) * height * 3);
+        for (int y = 0; y < height; ++y)
+        {
+            mapped.readRow(y, data + size_t(height - 1 - y) * width * 3);
+        }
+        if (reduce > 1)
+        {
+            reduceImage(data, width, height, reduce);
+        }
+        return data;
+    }
+
+    if (jpegFile(fileName))
+    {
+        JpegReader reader;
+        if (!reader.open(fileName, reduce))
+        {
+            error = reader.error();
+            return NULL;
+        }
+        width = reader.width();
+        height = reader.height();
+        const ptrdiff_t stride = ptrdiff_t(width) * 3;
+        unsigned char *data = (unsigned char*) malloc(size_t(height) * stride);
+        if (!reader.read(data + (height - 1) * stride, -stride, height))
+        {
+            error = reader.error();
+            free(data);
+            return NULL;
+        }
+        return data;
+    }
+
+    int nrChannels;
+    unsigned char *data = stbi_load(fileName, &width, &height, &nrChannels, 3);
+    if (!data)
+    {
+        error = stbi_failure_reason();
+        return NULL;
+    }
+    if (reduce > 1)
+    {
+        reduceImage(data, width, height, reduce);
+    }
+    return data;
+}
+
+unsigned char* loadImage(const char *fileName, int& width, int& height, int reduce)
+{
+    stbi_set_flip_vertically_on_load(true);
+
+    std::string error;
+    unsigned char *data = readImage(fileName, width, height, reduce, error);
+    if (!data)
+    {
+        std::cerr << "Failed to load texture image: " << error << std::endl;
+        exit(-1);
+    }
+    return data;
+}
+
+// size of the image loadImage returns, without decoding it
+void imageSize(const char *fileName, int& width, int& height, int reduce)
+{
+    if (mappedFormat(fileName) != MAPPED_NONE)
+    {
+        MappedImage mapped;
+        if (!mapped.open(fileName))
+        {
+            std::cerr << "Failed to load texture image: " << mapped.error() << std::endl;
+            exit(-1);
+        }
+        width = (mapped.width() + reduce - 1) / reduce;
+        height = (mapped.height() + reduce - 1) / reduce;
+        return;
+    }
+    if (jpegFile(fileName))
+    {
+        JpegReader reader;
+        if (!reader.open(fileName, reduce))
+        {
+            std::cerr << "Failed to load texture image: " << reader.error() << std::endl;
+            exit(-1);
+        }
+        width = reader.width();
+        height = reader.height();
+        return;
+    }
+
+    int nrChannels;
+    if (!stbi_info(fileName, &width, &height, &nrChannels))
+    {
+        std::cerr << "Failed to load texture image: " << stbi_failure_reason() << std::endl;
+        exit(-1);
+    }
+    width = (width + reduce - 1) / reduce;
+    height = (height + reduce - 1) / reduce;
+}
+
+// creates a texture from 8-bit RGB pixels
+void createTexture(const unsigned char *data, GLuint& texture, int width, int height)
 {
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    
-    stbi_set_flip_vertically_on_load(true);  
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-    // Loading Texture
-    int nrChannels;
-    unsigned char *data = stbi_load(fileName, &width, &height, &nrChannels, 0);
-    
-    // generating textures
-    if (data)
+    // RGB rows are not 4-byte aligned for every width
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+}
+
+// starts and stops the gpu timer of a pass
+void beginPass(const char *name)
+{
+    if (gpu_timer)
     {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        gpu_timer->begin(name);
     }
-    else
+}
+
+void endPass()
+{
+    if (gpu_timer)
     {
-        std::cerr << "Failed to load texture image: " << stbi_failure_reason() << std::endl;
-        exit(-1);
+        gpu_timer->end();
     }
-    stbi_image_free(data);
+}
+
+// the image covers the lower left texture_width x texture_height texels of the bound texture,
+// which is larger when the textures are reused for a smaller image
+// returns the size of one texel
+vec2 setRegion(Shader &shader, int region_width, int region_height)
+{
+    GLint width, height;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+
+    shader.setVec2("scale", float(region_width)/float(width), float(region_height)/float(height));
+    shader.setVec2("limit", (float(region_width) - 0.5f)/float(width), (float(region_height) - 0.5f)/float(height));
+    return vec2(1.0f/float(width), 1.0f/float(height));
+}
+
+vec2 setRegion(Shader &shader)
+{
+    return setRegion(shader, texture_width, texture_height);
 }
 
 // naive implementation O(n^2)
 // uses naive shader 
-void naive(Shader &shader, GLuint &texture, GLuint &VAO)
+// result is rendered into target framebuffer (0 is the window)
+void naive(Shader &shader, GLuint &texture, GLuint &VAO, GLuint target)
 {
     glViewport( 0, 0, texture_width, texture_height);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
     glBindTexture(GL_TEXTURE_2D, texture);
     shader.use();
+    vec2 texel = setRegion(shader);
+    shader.setVec2("move", texel.x, texel.y); // size of one texel
     glBindVertexArray(VAO);
+    beginPass("naive");
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    endPass();
 
     glViewport( 0, 0, window_width, window_height);
 }
 
 // two pass gaussian filter - O(2n)
 // uses two-pass shader
-void separated(Shader &shader1, Shader &shader2, GLuint& FBO1, GLuint& FBO2, GLuint& intermediate_texture, GLuint& filtered_texture, GLuint& texture, GLuint& VAO, GLuint& dirLoc)
+// vertical pass goes into FBO1, horizontal pass into target framebuffer (0 is the window)
+void separated(Shader &shader, GLuint& FBO1, GLuint& intermediate_texture, GLuint& texture, GLuint& VAO, GLuint& dirLoc, GLuint target)
 {
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    
     glViewport( 0, 0, texture_width, texture_height);
-    glBindFramebuffer(GL_FRAMEBUFFER, FBO1); // bind Framebuffer1
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    shader1.use(); // simple texture mapping shader
-    glBindTexture(GL_TEXTURE_2D, texture); // color attachment texture
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, FBO2); // bind Framebuffer2
-    glBindTexture(GL_TEXTURE_2D, intermediate_texture); // use the texture of the second one
-    shader2.use(); // two-pass gauss blur shader
-    glUniform2f(dirLoc, 0.0f, 1.0f/float(texture_height)); // vertical
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO1); // bind Framebuffer1
+    glBindTexture(GL_TEXTURE_2D, texture); // sample the source image directly
+    shader.use(); // two-pass gauss blur shader
+    vec2 texel = setRegion(shader);
+    glUniform2f(dirLoc, 0.0f, texel.y); // vertical
     glBindVertexArray(VAO);
+    beginPass("separated vertical");
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    endPass();
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glBindTexture(GL_TEXTURE_2D, filtered_texture); // use the texture of the second one (vertically blurred)
-    shader2.use(); // two-pass gauss blur shader
-    glUniform2f(dirLoc, 1.0f/float(texture_width), 0.0f); // horizontal
-    glBindVertexArray(VAO);
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+    glBindTexture(GL_TEXTURE_2D, intermediate_texture); // use the texture of the first one (vertically blurred)
+    texel = setRegion(shader);
+    glUniform2f(dirLoc, texel.x, 0.0f); // horizontal
+    beginPass("separated horizontal");
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    endPass();
     glViewport( 0, 0, window_width, window_height);
 }
 
 // uses two-pass gaussian with bilinear filtering
-void separated_bilinear(Shader &shader1, Shader &shader2, GLuint& FBO1, GLuint& FBO2, GLuint& intermediate_texture, GLuint& filtered_texture, GLuint& texture, GLuint& VAO, GLuint& dirLoc)
+void separated_bilinear(Shader &shader, GLuint& FBO1, GLuint& intermediate_texture, GLuint& texture, GLuint& VAO, GLuint& dirLoc, GLuint target)
 {
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    
     glViewport( 0, 0, texture_width, texture_height);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, FBO1); // bind Framebuffer0 
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    shader1.use(); // simple shader for texture mapping
-    glBindTexture(GL_TEXTURE_2D, texture); // color attachment texture
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO1); // bind Framebuffer1
+    glBindTexture(GL_TEXTURE_2D, texture); // sample the source image directly
+    shader.use(); // two-pass gauss shader with linear filtering
+    vec2 texel = setRegion(shader);
+    glUniform2f(dirLoc, 0.0f, texel.y); // vertical
     glBindVertexArray(VAO);
+    beginPass("bilinear vertical");
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    endPass();
 
-    glBindFramebuffer(GL_FRAMEBUFFER, FBO2); // bind second Framebuffer
-    glBindTexture(GL_TEXTURE_2D, intermediate_texture); // use the texture of the first one
-    shader2.use(); // two-pass gauss shader with linear filtering
-    glUniform2f(dirLoc, 0.0f, 1.0f/float(texture_height)); // vertical
-    glBindVertexArray(VAO);
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+    glBindTexture(GL_TEXTURE_2D, intermediate_texture); // use the texture of the first one (vertically blurred)
+    texel = setRegion(shader);
+    glUniform2f(dirLoc, texel.x, 0.0f); // horizontal
+    beginPass("bilinear horizontal");
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    endPass();
+    glViewport( 0, 0, window_width, window_height);
+}
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glBindTexture(GL_TEXTURE_2D, filtered_texture); // use the texture of the second one (vertically blurred image)
-    shader2.use();  // two-pass gauss shader with linear filtering
-    glUniform2f(dirLoc, 1.0f/float(texture_width), 0.0f); // horizontal
+// compute shader implementation, both passes run from shared memory and write with imageStore
+// vertical pass goes into intermediate_texture, horizontal pass into filtered_texture
+void compute(Shader &shader, GLuint& intermediate_texture, GLuint& filtered_texture, GLuint& texture)
+{
+    // a workgroup blurs a tile of 256 pixels of one column or row, the same as TILE in the shader
+    const GLuint tile = 256;
+
+    shader.use();
+    shader.setIVec2("size", texture_width, texture_height);
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glBindImageTexture(0, intermediate_texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    shader.setIVec2("dir", 0, 1); // vertical
+    beginPass("compute vertical");
+    glDispatchCompute((texture_height + tile - 1) / tile, texture_width, 1);
+    endPass();
+
+    // the horizontal pass reads what the vertical one stored
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    glBindTexture(GL_TEXTURE_2D, intermediate_texture);
+    glBindImageTexture(0, filtered_texture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+    shader.setIVec2("dir", 1, 0); // horizontal
+    beginPass("compute horizontal");
+    glDispatchCompute((texture_width + tile - 1) / tile, texture_height, 1);
+    endPass();
+
+    // the result is read back, blitted or sampled afterwards
+    glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+}
+
+// box approximation in compute shaders, every box is one sweep over all columns or rows, a workgroup per line
+// boxes go back and forth between intermediate_texture and box_texture, the last one stores into filtered_texture
+void box(Shader &shader, const std::vector<int> &radii, GLuint& intermediate_texture, GLuint& box_texture, GLuint& filtered_texture, GLuint& texture)
+{
+    const int boxes = int(radii.size());
+    const GLuint targets[2] = { intermediate_texture, box_texture };
+
+    shader.use();
+    shader.setIVec2("size", texture_width, texture_height);
+
+    GLuint source = texture;
+    for (int i = 0; i < 2 * boxes; ++i)
+    {
+        // columns first
+        const bool vertical = i < boxes;
+        const bool last = i + 1 == 2 * boxes;
+        const GLuint target = last ? filtered_texture : targets[i % 2];
+
+        glBindTexture(GL_TEXTURE_2D, source);
+        glBindImageTexture(0, target, 0, GL_FALSE, 0, GL_WRITE_ONLY, last ? GL_RGBA8 : GL_RGBA16F);
+        shader.setIVec2("dir", vertical ? 0 : 1, vertical ? 1 : 0);
+        shader.setInt("radius", radii[i % boxes]);
+        beginPass(vertical ? "box vertical" : "box horizontal");
+        glDispatchCompute(vertical ? texture_width : texture_height, 1, 1);
+        endPass();
+
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+        source = target;
+    }
+
+    // the result is read back, blitted or sampled afterwards
+    glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+}
+
+// draws the source_width x source_height image of source into the target_width x target_height image of target
+// ratio is the size of a target pixel in source texels, 2 for a halving and 0.5 for a doubling
+// shift is the source texel the target origin falls on
+void resample(Shader &shader, GLuint source, int source_width, int source_height, GLuint target, int target_width, int target_height, float ratio, float shift, GLuint &VAO)
+{
+    glViewport( 0, 0, target_width, target_height);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+    glBindTexture(GL_TEXTURE_2D, source);
+    shader.use();
+    GLint width, height;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    shader.setFloat("ratio", ratio);
+    shader.setVec2("shift", shift, shift);
+    shader.setVec2("move", 1.0f/float(width), 1.0f/float(height));
+    shader.setVec2("limit", (float(source_width) - 0.5f)/float(width), (float(source_height) - 0.5f)/float(height));
     glBindVertexArray(VAO);
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-    glViewport( 0, 0, window_width, window_height);
 }
 
-int main(int argc, char* argv[])
+// pyramid approximation for large sigmas, the image is halved levels times with 2x2 averages,
+// blurred with a small gaussian by the bilinear shader and doubled back with bilinear fetches
+// the levels have padding pixels of the clamped image on every side, so the coarse gaussian clamps far from the image
+// level k is in fbos[k - 1] and textures[k - 1], the coarse vertical pass goes into FBO1
+// result is rendered into target framebuffer (0 is the window)
+void pyramid(Shader &resample_shader, Shader &blur_shader, GLuint& dirLoc, int levels, int padding, const std::vector<GLuint>& fbos, const std::vector<GLuint>& textures,
+             GLuint& FBO1, GLuint& intermediate_texture, GLuint& texture, GLuint& VAO, GLuint target)
 {
-    if (argc <= 2)
+    std::vector<int> widths(levels + 1), heights(levels + 1);
+    widths[0] = texture_width;
+    heights[0] = texture_height;
+    for (int k = 1; k <= levels; ++k)
     {
-        std::cerr << "Wrong usage. Correct usage as follows: ./blur <image_to_be_blurred> <implementation_type>." << std::endl;
-        std::cerr << "For <implementation_type>, type 1 for naive implementation. 2 or 3 for faster result." << std::endl;
-        exit(-1);
+        widths[k] = (texture_width + 2 * padding + (1 << k) - 1) >> k;
+        heights[k] = (texture_height + 2 * padding + (1 << k) - 1) >> k;
     }
-    else if (argc > 3)
+
+    beginPass("pyramid down");
+    for (int k = 1; k <= levels; ++k)
     {
-        std::cerr << "Wrong usage. You have provided extra input." << std::endl;
-        std::cerr << "Correct usage as follows: ./blur <image_to_be_blurred> <type_of_implementation>." << std::endl;
-        exit(-1);
+        resample(resample_shader, k == 1 ? texture : textures[k - 2], widths[k - 1], heights[k - 1], fbos[k - 1], widths[k], heights[k],
+                 2.0f, k == 1 ? -float(padding) : 0.0f, VAO);
     }
+    endPass();
+
+    // the coarse level is blurred in place, through the intermediate texture
+    const GLuint coarse_source = levels ? textures[levels - 1] : texture;
+    const GLuint coarse_target = levels ? fbos[levels - 1] : target;
+    glViewport( 0, 0, widths[levels], heights[levels]);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO1);
+    glBindTexture(GL_TEXTURE_2D, coarse_source);
+    blur_shader.use();
+    vec2 texel = setRegion(blur_shader, widths[levels], heights[levels]);
+    glUniform2f(dirLoc, 0.0f, texel.y); // vertical
+    glBindVertexArray(VAO);
+    beginPass("pyramid vertical");
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    endPass();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, coarse_target);
+    glBindTexture(GL_TEXTURE_2D, intermediate_texture);
+    texel = setRegion(blur_shader, widths[levels], heights[levels]);
+    glUniform2f(dirLoc, texel.x, 0.0f); // horizontal
+    beginPass("pyramid horizontal");
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    endPass();
 
-    int type = atoi(argv[2]);
-    if (type < 1 || type > 3)
+    // every level is overwritten by the doubled level above it, the last doubling drops the padding
+    beginPass("pyramid up");
+    for (int k = levels; k >= 1; --k)
     {
-        std::cerr << "Invalid implementation type. Please choose between 1-3." << std::endl;
-        exit(-1);
+        resample(resample_shader, textures[k - 1], widths[k], heights[k], k == 1 ? target : fbos[k - 2], widths[k - 1], heights[k - 1],
+                 0.5f, k == 1 ? 0.5f * float(padding) : 0.0f, VAO);
     }
+    endPass();
+
+    glViewport( 0, 0, window_width, window_height);
+}
+
+// results that can be read back at the same time, batch mode picks one up while the next image is blurred
+static const int READBACK_SLOTS = 3;
+
+// OpenGL objects shared by the gpu implementations
+struct Pipeline
+{
+    Shader *naive_shader; // naive implementation of gaussian filter
+    Shader *separated_shader; // separated implementation of gaussian filter
+    Shader *linear_shader; // separated with bilinear filtering of gaussian filter
+    Shader *compute_shader; // separated in compute shaders, NULL without OpenGL 4.3
+    Shader *box_shader; // box approximation in compute shaders, NULL without OpenGL 4.3
+    Shader *resample_shader; // halves and doubles the levels of the pyramid
+    Shader *pyramid_shader; // bilinear shader with the small gaussian of the coarsest pyramid level
 
-    initialize(window_width, window_height, "Gaussian Blur");
+    GLuint dirLoc_sep; // two pass
+    GLuint dirLoc_sep_lin; // two pass with linear filtering
+    GLuint dirLoc_pyr; // coarsest pyramid level
 
+    GLuint VAO, VBO, EBO;
+
+    GLuint FBO1, intermediate_texture; // vertically blurred image
+    GLuint FBO2, filtered_texture; // final result when it is not drawn to the window
+    GLuint box_texture; // second intermediate of the box passes, only allocated when they run
+    std::vector<int> box_radii; // radii of the box passes of the current kernel
+    std::vector<GLuint> pyramid_fbos, pyramid_textures; // halved levels of the pyramid, only allocated when it runs
+    int pyramid_levels, pyramid_padding; // levels and clamped border of the current kernel
+    int width, height; // size of the image that is blurred
+    int capacity_width, capacity_height; // allocated size of the framebuffer textures, at least the image size
+
+    UploadRing *upload_ring; // pixel buffers the images are uploaded through
+    ReadbackRing *readback_ring; // pixel buffers results are read back through without stalling
+};
+
+// compute shader program, NULL if it does not build
+Shader *loadComputeShader(const char *fileName)
+{
+    Shader *shader = new Shader(fileName);
+    if (!shader->isValid())
+    {
+        delete shader;
+        return NULL;
+    }
+    return shader;
+}
+
+// compiles the shaders and creates the full screen quad
+// framebuffer textures get their storage in resizePipeline
+void createPipeline(Pipeline &pipeline)
+{
     // colored and texture vertices
     static const GLfloat vertices[] = {
         // positions            // colors         // texture coordinates
@@ -234,37 +697,35 @@ int main(int argc, char* argv[])
         0, 2, 3  // second triangle
     };
 
-    // simple texture shader
-    Shader shader1 = loadShaders("SimpleVertexShader.vertexshader", "SimpleFragmentShader.fragmentshader");
-    // naive implementation of gaussian filter
-    Shader shader2 = loadShaders("SimpleVertexShader.vertexshader", "naive.fragmentshader");
-    // separated implementation of gaussian filter
-    Shader shader3 = loadShaders("SimpleVertexShader.vertexshader", "separated.fragmentshader");
-    // separated with bilinear filtering of gaussian filter
-    Shader shader4 = loadShaders("SimpleVertexShader.vertexshader", "linear.fragmentshader");
-
-    GLuint texture;
-    texture_width = 0;
-    texture_height = 0;
+    pipeline.naive_shader = new Shader("SimpleVertexShader.vertexshader", "naive.fragmentshader");
+    pipeline.separated_shader = new Shader("SimpleVertexShader.vertexshader", "separated.fragmentshader");
+    pipeline.linear_shader = new Shader("SimpleVertexShader.vertexshader", "linear.fragmentshader");
+    pipeline.resample_shader = new Shader("SimpleVertexShader.vertexshader", "pyramid.fragmentshader");
+    pipeline.pyramid_shader = new Shader("SimpleVertexShader.vertexshader", "linear.fragmentshader");
 
-    loadTexture(argv[1], texture, texture_width, texture_height, type);
-
-    window_height = texture_height;
-    window_width = texture_width;
-    glfwSetWindowSize(win, window_width, window_height);
+    // compute shaders need OpenGL 4.3, the other implementations still work without
+    pipeline.compute_shader = NULL;
+    pipeline.box_shader = NULL;
+    if (GLEW_VERSION_4_3)
+    {
+        pipeline.compute_shader = loadComputeShader("compute.computeshader");
+        pipeline.box_shader = loadComputeShader("box.computeshader");
+    }
 
-    GLuint VBO, VAO, EBO;
+    pipeline.dirLoc_sep = glGetUniformLocation(pipeline.separated_shader->getProgramID(), "dir");
+    pipeline.dirLoc_sep_lin = glGetUniformLocation(pipeline.linear_shader->getProgramID(), "dir");
+    pipeline.dirLoc_pyr = glGetUniformLocation(pipeline.pyramid_shader->getProgramID(), "dir");
 
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+    glGenVertexArrays(1, &pipeline.VAO);
+    glGenBuffers(1, &pipeline.VBO);
+    glGenBuffers(1, &pipeline.EBO);
 
-    glBindVertexArray(VAO);
+    glBindVertexArray(pipeline.VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, pipeline.VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pipeline.EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
     // position attribute
@@ -280,93 +741,2074 @@ int main(int argc, char* argv[])
     glEnableVertexAttribArray(2);
 
     // create the first frame buffer object
-    unsigned int FBO1;
-    glGenFramebuffers(1, &FBO1);
-    glBindFramebuffer(GL_FRAMEBUFFER, FBO1);
-
+    glGenFramebuffers(1, &pipeline.FBO1);
     // create a color texture for intermediate buffer holding
-    unsigned int intermediate_texture;
-    glGenTextures(1, &intermediate_texture);
-    glBindTexture(GL_TEXTURE_2D, intermediate_texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, window_width, window_height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glGenTextures(1, &pipeline.intermediate_texture);
 
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, intermediate_texture, 0);
+    // second frame buffer object holds the final result when it is not drawn to the window
+    glGenFramebuffers(1, &pipeline.FBO2);
+    glGenTextures(1, &pipeline.filtered_texture);
+    pipeline.box_texture = 0;
+    pipeline.pyramid_levels = 0;
+    pipeline.pyramid_padding = 0;
 
-    unsigned int FBO2;
-    glGenFramebuffers(1, &FBO2);
-    glBindFramebuffer(GL_FRAMEBUFFER, FBO2);
+    pipeline.width = 0;
+    pipeline.height = 0;
+    pipeline.capacity_width = 0;
+    pipeline.capacity_height = 0;
 
-    unsigned int filtered_texture;
-    glGenTextures(1, &filtered_texture);
-    glBindTexture(GL_TEXTURE_2D, filtered_texture);
+    pipeline.upload_ring = new UploadRing();
+    pipeline.readback_ring = new ReadbackRing(READBACK_SLOTS);
+}
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, window_width, window_height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+// attaches a texture of the given format to a framebuffer
+void attachTexture(GLuint framebuffer, GLuint texture, GLint format, int width, int height)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, filtered_texture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
 
-    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE)
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
     {
         std::cout << "Framebuffer is not complete. " << std::endl;
     }
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
 
-    GLuint dirLoc_sep = glGetUniformLocation(shader3.getProgramID(), "dir"); // two pass
-    GLuint dirLoc_sep_lin = glGetUniformLocation(shader4.getProgramID(), "dir"); // two pass with linear filtering
+// sets the size of the image that is blurred
+// framebuffer textures only grow, smaller images use their lower left corner
+void resizePipeline(Pipeline &pipeline, int width, int height)
+{
+    pipeline.width = width;
+    pipeline.height = height;
 
-    // double lastTime = glfwGetTime();
-    // int nbFrames = 0;
- 
-    while(!glfwWindowShouldClose(win))
+    if (width <= pipeline.capacity_width && height <= pipeline.capacity_height)
     {
-        // measure time
-        // double currentTime = glfwGetTime();
-        // nbFrames += 1;
-        // // 1 sec passed
-        // if (currentTime - lastTime >= 1)
-        // {
-        //     printf("%f ms/frame\n", 1000/(double(nbFrames)));
-        //     nbFrames = 0;
-        //     lastTime += 1.0;
-        // }
+        return;
+    }
 
-        if (type == 1)
-        {
-            naive(shader2, texture, VAO);
-        }
-        else if (type == 2)
+    pipeline.capacity_width = std::max(width, pipeline.capacity_width);
+    pipeline.capacity_height = std::max(height, pipeline.capacity_height);
+
+    // keeps the vertically blurred image in half floats, so the second pass does not work on rounded values
+    // four channels because three channel formats can not be bound as images by the compute shaders
+    attachTexture(pipeline.FBO1, pipeline.intermediate_texture, GL_RGBA16F, pipeline.capacity_width, pipeline.capacity_height);
+    attachTexture(pipeline.FBO2, pipeline.filtered_texture, GL_RGBA8, pipeline.capacity_width, pipeline.capacity_height);
+}
+
+// pixels of the input of the headless modes, rows bottom-up unless top_down is set
+// 8-bit RGB files that can be mapped are used in place in the row order of the file, the blurs do not depend on it
+// unless any_order is false; everything else is loaded into owned, which the caller frees
+const unsigned char* mapInput(const char *fileName, int reduce, bool any_order, MappedImage &mapped, unsigned char *&owned,
+                              int &width, int &height, bool &top_down)
+{
+    owned = NULL;
+    top_down = false;
+    if (reduce == 1 && mappedFormat(fileName) != MAPPED_NONE && mapped.open(fileName) && mapped.rgb8() && (any_order || !mapped.topDown()))
+    {
+        width = mapped.width();
+        height = mapped.height();
+        top_down = mapped.topDown();
+        return mapped.pixels();
+    }
+    mapped.close();
+    owned = loadImage(fileName, width, height, reduce);
+    return owned;
+}
+
+// rows of the output file mapped for writing when it stores 8-bit RGB rows in the order top_down,
+// so results can be blurred or read back into it; NULL when the result has to go through writeImage
+unsigned char* mapOutput(const char *fileName, int width, int height, bool top_down, MappedImage &mapped)
+{
+    const int format = fileName ? mappedFormat(fileName) : MAPPED_NONE;
+    if ((format == MAPPED_PNM && top_down) || (format == MAPPED_RAW && !top_down))
+    {
+        if (mapped.create(fileName, format, width, height, 3))
         {
-            separated(shader1, shader3, FBO1, FBO2, intermediate_texture, filtered_texture, texture, VAO, dirLoc_sep);
+            return mapped.pixels();
         }
-        else if (type == 3)
+    }
+    return NULL;
+}
+
+// finishes the output of the headless modes, either the mapped file or the pixels written with writeImage
+bool writeResult(const char *fileName, MappedImage &mapped, const std::vector<unsigned char> &pixels, int width, int height, bool top_down,
+                 const EncodeOptions &encode)
+{
+    if (mapped.pixels())
+    {
+        if (!mapped.close())
         {
-            separated_bilinear(shader1, shader4, FBO1, FBO2, intermediate_texture, filtered_texture, texture, VAO, dirLoc_sep_lin);
+            std::cerr << "Failed to write output image: " << fileName << std::endl;
+            return false;
         }
-        
-        glfwSwapBuffers(win);
-        glfwPollEvents();
+        return true;
+    }
+    return !fileName || writeImage(fileName, pixels.data(), width, height, 3, !top_down, encode);
+}
+
+// makes a width x height image the image of the pipeline, it goes into the lower left corner of texture
+// texture is created with the capacity of the pipeline and only reallocated when that grows
+void prepareImage(Pipeline &pipeline, GLuint &texture, int width, int height)
+{
+    resizePipeline(pipeline, width, height);
+
+    GLint allocated_width = 0, allocated_height = 0;
+    if (texture)
+    {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &allocated_width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &allocated_height);
+    }
+    if (allocated_width != pipeline.capacity_width || allocated_height != pipeline.capacity_height)
+    {
+        glDeleteTextures(1, &texture);
+        createTexture(NULL, texture, pipeline.capacity_width, pipeline.capacity_height);
+    }
+
+    texture_width = width;
+    texture_height = height;
+}
+
+// uploads 8-bit RGB pixels into texture, see prepareImage
+// pixels go through the upload ring, so the call returns before the gpu has copied them
+void uploadImage(Pipeline &pipeline, GLuint &texture, const unsigned char *data, int width, int height)
+{
+    prepareImage(pipeline, texture, width, height);
+    pipeline.upload_ring->upload(texture, data, width, height);
+}
+
+// decodes an image file into texture
+// JPEG scanlines are decoded straight into the mapped slot of the upload ring, without a copy of the image
+void uploadFile(Pipeline &pipeline, GLuint &texture, const char *fileName, int reduce)
+{
+    if (!jpegFile(fileName))
+    {
+        int width, height;
+        unsigned char *data = loadImage(fileName, width, height, reduce);
+        uploadImage(pipeline, texture, data, width, height);
+        free(data);
+        return;
+    }
+
+    JpegReader reader;
+    if (!reader.open(fileName, reduce))
+    {
+        std::cerr << "Failed to load texture image: " << reader.error() << std::endl;
+        exit(-1);
+    }
+    const int width = reader.width(), height = reader.height();
+    prepareImage(pipeline, texture, width, height);
+
+    // the decoder hands out the rows top-down, so the bands go from the top of the texture down
+    const ptrdiff_t stride = ptrdiff_t(width) * 3;
+    const int band = pipeline.upload_ring->bandRows(width);
+    bool ok = true;
+    for (int top = height; top > 0 && ok; top -= band)
+    {
+        const int rows = std::min(band, top);
+        unsigned char *slot = pipeline.upload_ring->map(width, rows);
+        ok = reader.read(slot + (rows - 1) * stride, -stride, rows);
+        pipeline.upload_ring->commit(texture, top - rows);
+    }
+    if (!ok)
+    {
+        std::cerr << "Failed to load texture image: " << reader.error() << std::endl;
+        exit(-1);
+    }
+}
+
+// uploads the kernel weights of the blur shaders
+void setKernel(Shader &shader, const Kernel &kernel)
+{
+    shader.use();
+    shader.setInt("radius", kernel.radius);
+    shader.setFloatArray("weights", kernel.weights.data(), kernel.radius + 1);
+}
+
+// uploads the merged taps of the bilinear shader
+void setLinearKernel(Shader &shader, const Kernel &kernel)
+{
+    shader.use();
+    shader.setInt("taps", int(kernel.linear_weights.size()));
+    shader.setFloatArray("offsets", kernel.linear_offsets.data(), int(kernel.linear_offsets.size()));
+    shader.setFloatArray("weights", kernel.linear_weights.data(), int(kernel.linear_weights.size()));
+}
+
+// weights stay in the programs, they only have to be set when the kernel changes
+// weights larger than the arrays of the shaders are not set, the box passes work with any radius
+void setPipelineKernel(Pipeline &pipeline, const Kernel &kernel)
+{
+    pipeline.box_radii = kernel.box_radii;
+    // +-3 sigma of padding, whole texels on every level
+    const int block = 1 << kernel.pyramid_levels;
+    pipeline.pyramid_levels = kernel.pyramid_levels;
+    pipeline.pyramid_padding = (gaussianRadius(kernel.sigma) + block - 1) / block * block;
+    setLinearKernel(*pipeline.pyramid_shader, createKernel(kernel.pyramid_sigma, 0));
+    if (kernel.radius > MAX_RADIUS)
+    {
+        return;
+    }
+
+    setKernel(*pipeline.naive_shader, kernel);
+    setKernel(*pipeline.separated_shader, kernel);
+    setLinearKernel(*pipeline.linear_shader, kernel);
+    if (pipeline.compute_shader)
+    {
+        setKernel(*pipeline.compute_shader, kernel);
+    }
+}
+
+// gives the second box intermediate the size of the other framebuffer textures
+void allocateBoxTexture(Pipeline &pipeline)
+{
+    GLint width = 0, height = 0;
+    if (pipeline.box_texture)
+    {
+        glBindTexture(GL_TEXTURE_2D, pipeline.box_texture);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    }
+    else
+    {
+        glGenTextures(1, &pipeline.box_texture);
+        glBindTexture(GL_TEXTURE_2D, pipeline.box_texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    if (width != pipeline.capacity_width || height != pipeline.capacity_height)
+    {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, pipeline.capacity_width, pipeline.capacity_height, 0, GL_RGBA, GL_FLOAT, NULL);
+    }
+}
+
+// gives the pyramid a half float framebuffer texture for each level, every one half the size of the one below
+// like the other framebuffer textures they only grow
+void allocatePyramid(Pipeline &pipeline, int levels, int padding)
+{
+    while (int(pipeline.pyramid_textures.size()) < levels)
+    {
+        GLuint fbo, texture;
+        glGenFramebuffers(1, &fbo);
+        glGenTextures(1, &texture);
+        pipeline.pyramid_fbos.push_back(fbo);
+        pipeline.pyramid_textures.push_back(texture);
+    }
+
+    for (int k = 1; k <= levels; ++k)
+    {
+        const int width = (pipeline.capacity_width + 2 * padding + (1 << k) - 1) >> k;
+        const int height = (pipeline.capacity_height + 2 * padding + (1 << k) - 1) >> k;
+
+        GLint allocated_width, allocated_height;
+        glBindTexture(GL_TEXTURE_2D, pipeline.pyramid_textures[k - 1]);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &allocated_width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &allocated_height);
+        if (allocated_width < width || allocated_height < height)
+        {
+            attachTexture(pipeline.pyramid_fbos[k - 1], pipeline.pyramid_textures[k - 1], GL_RGBA16F, std::max(width, allocated_width), std::max(height, allocated_height));
+        }
+    }
+}
+
+// runs the gpu implementation of the given type on texture into target framebuffer
+// the compute implementation always stores into FBO2
+void blur(Pipeline &pipeline, int type, GLuint &texture, GLuint target)
+{
+    if (type == 1)
+    {
+        naive(*pipeline.naive_shader, texture, pipeline.VAO, target);
+    }
+    else if (type == 2)
+    {
+        separated(*pipeline.separated_shader, pipeline.FBO1, pipeline.intermediate_texture, texture, pipeline.VAO, pipeline.dirLoc_sep, target);
+    }
+    else if (type == 3)
+    {
+        separated_bilinear(*pipeline.linear_shader, pipeline.FBO1, pipeline.intermediate_texture, texture, pipeline.VAO, pipeline.dirLoc_sep_lin, target);
+    }
+    else if (type == 5 && pipeline.compute_shader)
+    {
+        compute(*pipeline.compute_shader, pipeline.intermediate_texture, pipeline.filtered_texture, texture);
+    }
+    else if (type == 7 && pipeline.box_shader)
+    {
+        allocateBoxTexture(pipeline);
+        box(*pipeline.box_shader, pipeline.box_radii, pipeline.intermediate_texture, pipeline.box_texture, pipeline.filtered_texture, texture);
+    }
+    else if (type == 9)
+    {
+        allocatePyramid(pipeline, pipeline.pyramid_levels, pipeline.pyramid_padding);
+        pyramid(*pipeline.resample_shader, *pipeline.pyramid_shader, pipeline.dirLoc_pyr, pipeline.pyramid_levels, pipeline.pyramid_padding, pipeline.pyramid_fbos, pipeline.pyramid_textures,
+                pipeline.FBO1, pipeline.intermediate_texture, texture, pipeline.VAO, target);
+    }
+    else if (type == 5 || type == 7)
+    {
+        // e.g. on OpenGL 3.3; the separated fragment shaders blur with the gaussian itself,
+        // which for type 7 is close to but not the same as its box approximation
+        static bool warned = false;
+        if (!warned)
+        {
+            std::cerr << "Compute shaders are not available, using the separated implementation." << std::endl;
+            warned = true;
+        }
+        separated(*pipeline.separated_shader, pipeline.FBO1, pipeline.intermediate_texture, texture, pipeline.VAO, pipeline.dirLoc_sep, target);
+    }
+}
+
+// reason a gpu implementation can not run with this kernel, NULL if it can
+const char *unsupported(Pipeline &pipeline, int type, const Kernel &kernel)
+{
+    if (radiusLimited(type) && kernel.radius > MAX_RADIUS)
+    {
+        return "radius too large for the shaders";
+    }
+    if ((type == 5 && !pipeline.compute_shader) || (type == 7 && !pipeline.box_shader))
+    {
+        return "compute shaders not available";
+    }
+    return NULL;
+}
+
+// reads the result in FBO2 back, rows come bottom-up
+void readResult(Pipeline &pipeline, unsigned char *pixels)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, pipeline.FBO2);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, pipeline.width, pipeline.height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void deletePipeline(Pipeline &pipeline)
+{
+    // Cleanup VBO
+    glDeleteVertexArrays(1, &pipeline.VAO);
+    glDeleteBuffers(1, &pipeline.VBO);
+    glDeleteBuffers(1, &pipeline.EBO);
+    // Cleanup FBOs
+    glDeleteFramebuffers(1, &pipeline.FBO1);
+    glDeleteFramebuffers(1, &pipeline.FBO2);
+    if (!pipeline.pyramid_fbos.empty())
+    {
+        glDeleteFramebuffers(GLsizei(pipeline.pyramid_fbos.size()), pipeline.pyramid_fbos.data());
+        glDeleteTextures(GLsizei(pipeline.pyramid_textures.size()), pipeline.pyramid_textures.data());
+    }
+    // Cleanup textures
+    glDeleteTextures(1, &pipeline.intermediate_texture);
+    glDeleteTextures(1, &pipeline.filtered_texture);
+    glDeleteTextures(1, &pipeline.box_texture);
+
+    delete pipeline.upload_ring;
+    delete pipeline.readback_ring;
+
+    delete pipeline.naive_shader;
+    delete pipeline.separated_shader;
+    delete pipeline.linear_shader;
+    delete pipeline.compute_shader;
+    delete pipeline.box_shader;
+    delete pipeline.resample_shader;
+    delete pipeline.pyramid_shader;
+}
+
+// the separated implementation hands large kernels and kernel images to the fft, it is faster beyond the break even radius
+static bool fftBlur(int type, const Kernel &kernel)
+{
+    return type == 10 || (type == 4 && (!kernel.psf.empty() || kernel.radius >= FFT_BREAK_EVEN_RADIUS));
+}
+
+// name of the implementation that really runs for type, the fft for large kernels of type 4
+static const char *engineName(int type, const Kernel &kernel)
+{
+    return fftBlur(type, kernel) ? implementationName(10) : implementationName(type);
+}
+
+// runs the cpu implementation of the given type
+void cpuBlur(int type, const unsigned char *src, unsigned char *dst, int width, int height, int channels, const Kernel &kernel, ThreadPool &pool)
+{
+    if (type == 6)
+    {
+        cpu_box(src, dst, width, height, channels, kernel, pool);
+    }
+    else if (type == 8)
+    {
+        cpu_iir(src, dst, width, height, channels, kernel, pool);
+    }
+    else if (fftBlur(type, kernel))
+    {
+        cpu_fft(src, dst, width, height, channels, kernel, pool);
+    }
+    else
+    {
+        cpu_separated(src, dst, width, height, channels, kernel, pool);
+    }
+}
+
+// distance from which pixels no longer change a result pixel, the apron tiles need
+// the recursive filter never ends, at 4 sigma its response is below 1/1000 of the peak
+int blurReach(int type, const Kernel &kernel)
+{
+    if (!kernel.psf.empty())
+    {
+        return std::max(kernel.psf_width, kernel.psf_height) / 2;
+    }
+    if (type == 6 || type == 7)
+    {
+        int reach = 0;
+        for (size_t i = 0; i < kernel.box_radii.size(); ++i)
+        {
+            reach += kernel.box_radii[i];
+        }
+        return reach;
+    }
+    if (type == 8)
+    {
+        return int(std::ceil(4.0f * kernel.sigma));
+    }
+    if (type == 9)
+    {
+        // the coarse gaussian and the resampling on both ways around it
+        return gaussianRadius(kernel.sigma) + (2 << kernel.pyramid_levels);
+    }
+    return kernel.radius;
+}
+
+// grid of the implementation, tiles have to start on it to blur like the whole image
+int blurAlign(int type, const Kernel &kernel)
+{
+    return type == 9 ? 1 << kernel.pyramid_levels : 1;
+}
+
+// tiles of an image larger than tile_size, exits if the apron does not fit
+std::vector<Tile> imageTiles(int type, const Kernel &kernel, int width, int height, int tile_size)
+{
+    const int reach = blurReach(type, kernel);
+    std::vector<Tile> tiles = splitTiles(width, height, tile_size, reach, blurAlign(type, kernel));
+    if (tiles.empty())
+    {
+        std::cerr << "Tiles of " << tile_size << " pixels are too small for an apron of " << reach << " pixels." << std::endl;
+        exit(-1);
+    }
+    return tiles;
+}
+
+// blurs an image tile by tile on the gpu, every tile is uploaded, blurred and read back on its own,
+// so the textures only need the size of a tile
+void gpuBlurTiles(Pipeline &pipeline, GLuint &texture, int type, const std::vector<Tile> &tiles, const unsigned char *src, unsigned char *dst, int width)
+{
+    std::vector<unsigned char> pixels, result;
+    for (size_t i = 0; i < tiles.size(); ++i)
+    {
+        const Tile &tile = tiles[i];
+        pixels.resize(size_t(tile.width) * tile.height * 3);
+        result.resize(pixels.size());
+
+        copyTile(src, width, 3, tile, pixels.data());
+        uploadImage(pipeline, texture, pixels.data(), tile.width, tile.height);
+        blur(pipeline, type, texture, pipeline.FBO2);
+        readResult(pipeline, result.data());
+        storeTile(result.data(), tile, 3, dst, width);
+    }
+}
+
+// blurs an image tile by tile on the cpu, the buffers of the implementations only need the size of a tile
+void cpuBlurTiles(int type, const std::vector<Tile> &tiles, const unsigned char *src, unsigned char *dst, int width, const Kernel &kernel, ThreadPool &pool)
+{
+    std::vector<unsigned char> pixels, result;
+    for (size_t i = 0; i < tiles.size(); ++i)
+    {
+        const Tile &tile = tiles[i];
+        pixels.resize(size_t(tile.width) * tile.height * 3);
+        result.resize(pixels.size());
+
+        copyTile(src, width, 3, tile, pixels.data());
+        cpuBlur(type, pixels.data(), result.data(), tile.width, tile.height, 3, kernel, pool);
+        storeTile(result.data(), tile, 3, dst, width);
+    }
+}
+
+// command line options
+struct Options
+{
+    bool headless;
+    const char *output_file;
+    int threads;
+    bool timing;
+    int repeat; // 0 means the default of the mode
+    float sigma; // 0 means the default kernel
+    int radius; // 0 means derived from sigma
+    int boxes; // box blurs of the box implementations
+
+    bool bench;
+    std::string sizes;
+    std::string sigmas;
+    std::string implementations;
+    int warmup;
+    std::string format;
+
+    bool verify;
+    double min_psnr; // verification fails below this, 0 never fails
+
+    bool batch;
+    bool stream; // blur the cpu implementation row by row from the input file into the output file
+    bool video; // blur frames from stdin to stdout
+    int video_width, video_height; // size of raw RGB frames, 0 for Y4M
+
+    const char *psf; // kernel image replacing the gaussian, NULL for the gaussian
+    int tile; // largest tile side, 0 means the largest texture on the gpu and whole images on the cpu
+    int reduce; // inputs are decoded at 1/reduce of their size
+    int quality; // of JPEG outputs
+    int compression; // of PNG outputs
+};
+
+// encoder settings of the options, PNG outputs are deflated on pool
+EncodeOptions encodeOptions(const Options &options, ThreadPool *pool)
+{
+    EncodeOptions encode;
+    encode.quality = options.quality;
+    encode.compression = options.compression;
+    encode.pool = pool;
+    return encode;
+}
+
+void printUsage()
+{
+    std::cerr << "Correct usage as follows: ./blur <image_to_be_blurred> <implementation_type> [options]." << std::endl;
+    std::cerr << "For <implementation_type>, type 1 for naive implementation. 2 or 3 for faster result. 4 for the cpu. 5 for compute shaders (OpenGL 4.3)." << std::endl;
+    std::cerr << "6 (cpu) and 7 (compute shaders) approximate the gaussian with box blurs, their cost does not grow with sigma." << std::endl;
+    std::cerr << "8 is a recursive (IIR) gaussian on the cpu, also constant cost for any sigma." << std::endl;
+    std::cerr << "9 blurs a downsampled pyramid with a small gaussian on the gpu, for large sigmas." << std::endl;
+    std::cerr << "10 convolves through the fft on the cpu, 4 switches to it from radius " << FFT_BREAK_EVEN_RADIUS << " on." << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --headless         render once without a window and exit" << std::endl;
+    std::cerr << "  --output <file>    write the blurred image (.jpg, .png, .ppm, .pfm or .raw), S saves it in the window" << std::endl;
+    std::cerr << "  --quality <q>      JPEG quality of the output, 1-100 (default: 95)" << std::endl;
+    std::cerr << "  --compression <n>  deflate level of PNG outputs, 0-9 (default: 6)" << std::endl;
+    std::cerr << "  --threads <n>      worker threads of the cpu implementation (default: all cores)" << std::endl;
+    std::cerr << "  --sigma <s>        standard deviation of the gaussian (default: 10)" << std::endl;
+    std::cerr << "  --radius <r>       taps on each side of the center (default: 3 * sigma, 16 for the default sigma)" << std::endl;
+    std::cerr << "  --boxes <n>        box blurs of the box implementations 6 and 7 (default: 3)" << std::endl;
+    std::cerr << "  --tile <n>         blur images larger than n x n in tiles (default: the largest texture on the gpu, no tiles on the cpu)" << std::endl;
+    std::cerr << "  --reduce <n>       decode inputs at 1/n of their size, n = 2, 4 or 8 (JPEG is scaled by the decoder)" << std::endl;
+    std::cerr << "  --psf <image>      convolve with a grayscale kernel image instead of the gaussian (types 4 and 10, headless)" << std::endl;
+    std::cerr << "  --stream           blur with type 4 row by row from the input (JPEG, PPM, PFM, RAW) into --output (JPEG, PNG, PPM, PFM, RAW), for images larger than memory" << std::endl;
+    std::cerr << "  --timing           measure the gpu time of every pass and print min/median/p99" << std::endl;
+    std::cerr << "  --repeat <n>       blur n times in headless mode (default: 1)" << std::endl;
+    std::cerr << "Benchmark: ./blur --bench [options], runs headless on synthetic images" << std::endl;
+    std::cerr << "  --sizes <list>     image sizes (default: 256,512,1024,2048,4096,8192,16384)" << std::endl;
+    std::cerr << "  --sigmas <list>    sigmas (default: 2,5,10,20,40)" << std::endl;
+    std::cerr << "  --types <list>     implementation types (default: 1,2,3,4,5,6,7,8,9,10)" << std::endl;
+    std::cerr << "  --warmup <n>       untimed runs before measuring (default: 2)" << std::endl;
+    std::cerr << "  --repeat <n>       timed runs (default: 10)" << std::endl;
+    std::cerr << "  --format <f>       csv or json (default: csv), written to --output or stdout" << std::endl;
+    std::cerr << "Verification: ./blur --verify [image] [options], compares every implementation with a double precision blur" << std::endl;
+    std::cerr << "  --types <list>     implementation types (default: 1,2,3,4,5,6,7,8,9,10)" << std::endl;
+    std::cerr << "  --min-psnr <db>    exit with an error if an implementation is below this PSNR" << std::endl;
+    std::cerr << "  a synthetic 512x512 image is used when no image is given" << std::endl;
+    std::cerr << "Batch: ./blur --batch <implementation_type> <input>... [--output <directory>] [options]" << std::endl;
+    std::cerr << "  an input is an image, a directory of images or @file with one path per line" << std::endl;
+    std::cerr << "  outputs keep the input name, .jpg for JPEG inputs, .png, .pfm and .raw stay and .ppm otherwise" << std::endl;
+    std::cerr << "Video: ./blur --video <implementation_type> [--video-size <w>x<h>] [options] < input > output" << std::endl;
+    std::cerr << "  blurs a Y4M stream (8-bit 4:2:0, 4:2:2, 4:1:1, 4:4:4 or mono) frame by frame, Y, U and V separately" << std::endl;
+    std::cerr << "  --video-size <w>x<h>  the input is raw top-down RGB frames of this size instead" << std::endl;
+}
+
+// kernel of the --sigma and --radius options
+// without any option the kernel of the original shaders is used
+Kernel optionKernel(const Options &options)
+{
+    Kernel kernel;
+    if (options.sigma == 0.0f)
+    {
+        kernel = createKernel(DEFAULT_SIGMA, options.radius ? options.radius : DEFAULT_RADIUS, options.boxes);
+    }
+    else
+    {
+        kernel = createKernel(options.sigma, options.radius, options.boxes);
+    }
+
+    if (options.psf)
+    {
+        // flipped like the images, so it is not mirrored vertically against them
+        int width, height, channels;
+        stbi_set_flip_vertically_on_load(true);
+        unsigned char *pixels = stbi_load(options.psf, &width, &height, &channels, 1);
+        if (!pixels)
+        {
+            std::cerr << "Failed to load kernel image: " << stbi_failure_reason() << std::endl;
+            exit(-1);
+        }
+        bool valid = setPsf(kernel, pixels, width, height);
+        stbi_image_free(pixels);
+        if (!valid)
+        {
+            std::cerr << "Kernel image " << options.psf << " is black." << std::endl;
+            exit(-1);
+        }
+    }
+    return kernel;
+}
+
+// kernel images only work with the fft, which type 4 hands them to
+static bool psfType(int type)
+{
+    return type == 4 || type == 10;
+}
+
+// the naive shader reads (2r+1)^2 texels per pixel, larger configurations would run for hours
+static const double NAIVE_FETCH_LIMIT = 1.0e11;
+
+// runs every implementation over synthetic images of all sizes and sigmas
+int runBenchmark(const Options &options)
+{
+    std::vector<float> sizes = parseList(options.sizes);
+    std::vector<float> sigmas = parseList(options.sigmas);
+    std::vector<float> types = parseList(options.implementations);
+    const int runs = options.repeat > 0 ? options.repeat : 10;
+
+    // a GPU is only needed when one of the shader implementations is measured
+    bool gpu = false;
+    for (size_t i = 0; i < types.size(); ++i)
+    {
+        gpu = gpu || gpuType(int(types[i]));
+    }
+
+    Pipeline pipeline;
+    GLint max_texture_size = 0;
+    if (gpu)
+    {
+        initializeHeadless();
+        createPipeline(pipeline);
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+    }
+
+    ThreadPool pool(options.threads);
+    std::vector<BenchRecord> records;
+    GLuint texture = 0;
+
+    for (size_t s = 0; s < sizes.size(); ++s)
+    {
+        const int size = int(sizes[s]);
+        std::vector<unsigned char> pixels = syntheticImage(size, size, unsigned(size));
+        std::vector<unsigned char> result;
+
+        const bool fits = size <= max_texture_size;
+        if (gpu && fits)
+        {
+            uploadImage(pipeline, texture, pixels.data(), size, size);
+        }
+
+        for (size_t k = 0; k < sigmas.size(); ++k)
+        {
+            Kernel kernel = createKernel(sigmas[k], options.radius, options.boxes);
+            if (gpu)
+            {
+                setPipelineKernel(pipeline, kernel);
+            }
+
+            for (size_t t = 0; t < types.size(); ++t)
+            {
+                const int type = int(types[t]);
+                BenchRecord record;
+                record.implementation = engineName(type, kernel);
+                record.width = size;
+                record.height = size;
+                record.sigma = kernel.sigma;
+                record.radius = kernel.radius;
+                record.timing = summarize(std::vector<double>());
+
+                const double fetches = double(size) * size * (2 * kernel.radius + 1) * (2 * kernel.radius + 1);
+                if (!validType(type))
+                {
+                    record.skipped = "unknown implementation type";
+                }
+                else if (gpuType(type) && !fits)
+                {
+                    record.skipped = "larger than GL_MAX_TEXTURE_SIZE";
+                }
+                else if (gpuType(type) && unsupported(pipeline, type, kernel))
+                {
+                    record.skipped = unsupported(pipeline, type, kernel);
+                }
+                else if (type == 1 && fetches > NAIVE_FETCH_LIMIT)
+                {
+                    record.skipped = "too many texel fetches for the naive shader";
+                }
+                else if (!gpuType(type))
+                {
+                    result.resize(pixels.size());
+                    record.timing = measure(options.warmup, runs, [&]()
+                    {
+                        cpuBlur(type, pixels.data(), result.data(), size, size, 3, kernel, pool);
+                    });
+                }
+                else
+                {
+                    record.timing = measure(options.warmup, runs, [&]()
+                    {
+                        blur(pipeline, type, texture, pipeline.FBO2);
+                        glFinish();
+                    });
+                }
+
+                std::cerr << record.implementation << " " << size << "x" << size << " sigma " << record.sigma << ": ";
+                if (record.skipped.empty())
+                {
+                    std::cerr << record.timing.median << " ms" << std::endl;
+                }
+                else
+                {
+                    std::cerr << "skipped, " << record.skipped << std::endl;
+                }
+                records.push_back(record);
+            }
+        }
+
+    }
+
+    if (gpu)
+    {
+        glDeleteTextures(1, &texture);
+        deletePipeline(pipeline);
+        terminateHeadless();
+    }
+
+    std::ofstream file;
+    if (options.output_file)
+    {
+        file.open(options.output_file);
+        if (!file)
+        {
+            std::cerr << "Failed to open benchmark output: " << options.output_file << std::endl;
+            return -1;
+        }
+    }
+    std::ostream &out = options.output_file ? file : std::cout;
+
+    if (options.format == "json")
+    {
+        writeJSON(out, records);
+    }
+    else
+    {
+        writeCSV(out, records);
+    }
+    return 0;
+}
+
+// runs every implementation once and compares it with the double precision reference
+int runVerification(const Options &options, const std::vector<const char*> &args)
+{
+    std::vector<float> types = parseList(options.implementations);
+    Kernel kernel = optionKernel(options);
+    ThreadPool pool(options.threads);
+
+    int width = 512, height = 512;
+    std::vector<unsigned char> source;
+    if (!args.empty())
+    {
+        unsigned char *data = loadImage(args[0], width, height, options.reduce);
+        source.assign(data, data + size_t(width) * height * 3);
+        free(data);
+    }
+    else
+    {
+        source = syntheticImage(width, height, 1);
+    }
+
+    std::vector<double> reference = referenceBlur(source.data(), width, height, 3, kernel, pool);
+
+    bool gpu = false;
+    for (size_t i = 0; i < types.size(); ++i)
+    {
+        gpu = gpu || gpuType(int(types[i]));
+    }
+
+    Pipeline pipeline;
+    GLuint texture = 0;
+    if (gpu)
+    {
+        initializeHeadless();
+        createPipeline(pipeline);
+        uploadImage(pipeline, texture, source.data(), width, height);
+        setPipelineKernel(pipeline, kernel);
+    }
+
+    printf("reference: %dx%d, sigma %g, radius %d, double precision without rounding\n", width, height, kernel.sigma, kernel.radius);
+    printf("%-20s %9s %8s %8s %8s %8s %8s %8s %8s\n", "implementation", "psnr_db", "max_err", "max_r", "max_g", "max_b", "rmse_r", "rmse_g", "rmse_b");
+
+    // the best any 8-bit output can do, everything above this is error of the implementation
+    std::vector<unsigned char> result(source.size());
+    for (size_t i = 0; i < result.size(); ++i)
+    {
+        result[i] = (unsigned char) std::min(255.0, std::floor(reference[i] + 0.5));
+    }
+
+    int status = 0;
+    for (size_t t = 0; t <= types.size(); ++t)
+    {
+        const int type = t == 0 ? 0 : int(types[t - 1]);
+        const char *name = t == 0 ? "rounded_reference" : engineName(type, kernel);
+
+        if (type == 0)
+        {
+            // result already holds the rounded reference
+        }
+        else if (!validType(type))
+        {
+            printf("%-20s skipped, unknown implementation type\n", name);
+            continue;
+        }
+        else if (!gpuType(type))
+        {
+            cpuBlur(type, source.data(), result.data(), width, height, 3, kernel, pool);
+        }
+        else
+        {
+            const char *reason = unsupported(pipeline, type, kernel);
+            if (reason)
+            {
+                printf("%-20s skipped, %s\n", name, reason);
+                continue;
+            }
+            blur(pipeline, type, texture, pipeline.FBO2);
+            readResult(pipeline, result.data());
+        }
+
+        ImageError error = compareImages(result.data(), reference, width, height, 3);
+        printf("%-20s %9.2f %8.3f %8.3f %8.3f %8.3f %8.4f %8.4f %8.4f\n", name, error.psnr, error.max_error,
+               error.channel_max[0], error.channel_max[1], error.channel_max[2],
+               error.channel_rmse[0], error.channel_rmse[1], error.channel_rmse[2]);
+
+        if (type != 0 && error.psnr < options.min_psnr)
+        {
+            status = 1;
+        }
+    }
+
+    if (gpu)
+    {
+        glDeleteTextures(1, &texture);
+        deletePipeline(pipeline);
+        terminateHeadless();
+    }
+
+    if (status)
+    {
+        std::cerr << "At least one implementation is below " << options.min_psnr << " dB." << std::endl;
+    }
+    return status;
+}
+
+// rows read, blurred and written per step of --stream, at least one per thread
+const int STREAM_BLOCK = 16;
+
+// blurs an image from the input file into the output file a block of rows at a time
+// only the ring of the blur and a block of input and output rows are in memory, not the image
+int runStream(const Options &options, const char *input, int type, const Kernel &kernel)
+{
+    if (type != 4 || options.psf)
+    {
+        std::cerr << "--stream works with the separated cpu implementation, type 4, and the gaussian." << std::endl;
+        exit(-1);
+    }
+    if (!options.output_file)
+    {
+        std::cerr << "--stream needs --output." << std::endl;
+        exit(-1);
+    }
+
+    RowReader reader;
+    if (!reader.open(input, options.reduce))
+    {
+        std::cerr << "Failed to load texture image: " << reader.error() << std::endl;
+        exit(-1);
+    }
+    const int width = reader.width(), height = reader.height();
+    ThreadPool pool(options.threads);
+    RowWriter writer;
+    if (!writer.open(options.output_file, width, height, 3, encodeOptions(options, &pool)))
+    {
+        std::cerr << "Failed to write output image: " << options.output_file << std::endl;
+        return -1;
+    }
+
+    const int block = std::max(STREAM_BLOCK, pool.size());
+    const ptrdiff_t stride = ptrdiff_t(width) * 3;
+    StreamingBlur blur(width, height, 3, kernel, block);
+    std::vector<unsigned char> in(block * stride), out(block * stride);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool ok = true;
+    for (int y = 0; y < height && ok; )
+    {
+        const int count = std::min(block, height - y);
+        if (!reader.read(in.data(), stride, count))
+        {
+            std::cerr << input << ": " << reader.error() << std::endl;
+            ok = false;
+            break;
+        }
+        blur.push(in.data(), count, pool);
+        y += count;
+
+        int ready;
+        while (ok && (ready = blur.pull(out.data(), block, pool)) > 0)
+        {
+            ok = writer.write(out.data(), stride, ready);
+        }
+    }
+    ok = writer.close() && ok;
+    if (!ok)
+    {
+        std::cerr << "Failed to write output image: " << options.output_file << std::endl;
+        return -1;
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    const double ring_mb = (2.0 * kernel.radius + block) * stride * sizeof(float) / (1024.0 * 1024.0);
+    std::cout << "stream: " << ms << " ms with decode and encode, " << double(width) * height / (ms * 1000.0) << " MP/s on "
+              << pool.size() << " threads, " << ring_mb << " MB of rows" << std::endl;
+    return 0;
+}
+
+// an image on its way through the stages of batch mode
+struct BatchImage
+{
+    std::string input;
+    unsigned char *pixels; // decoded by readImage or in mapped, rows bottom-up unless top_down
+    std::shared_ptr<MappedImage> mapped; // 8-bit RGB files are used in place
+    bool top_down;
+    int width, height;
+    std::vector<unsigned char> result;
+    int slot; // readback ring slot the result is read into
+};
+
+// blurs many images with one context, the shaders and framebuffers are reused for all of them
+// decoding and encoding run on worker threads, so the GL thread only uploads, blurs and reads back
+int runBatch(const Options &options, const std::vector<const char*> &args)
+{
+    if (args.size() < 2)
+    {
+        std::cerr << "Wrong usage. ";
+        printUsage();
+        exit(-1);
+    }
+
+    int type = atoi(args[0]);
+    if (!validType(type))
+    {
+        std::cerr << "Invalid implementation type. Please choose between 1-" << IMPLEMENTATION_COUNT << "." << std::endl;
+        exit(-1);
+    }
+
+    Kernel kernel = optionKernel(options);
+    if (radiusLimited(type) && kernel.radius > MAX_RADIUS)
+    {
+        std::cerr << "Radius " << kernel.radius << " is too large for the shaders, maximum is " << MAX_RADIUS << "." << std::endl;
+        exit(-1);
+    }
+    if (options.psf && !psfType(type))
+    {
+        std::cerr << "A kernel image needs the fft implementation, type 4 or 10." << std::endl;
+        exit(-1);
+    }
+
+    std::vector<std::string> inputs = batchInputs(std::vector<const char*>(args.begin() + 1, args.end()));
+
+    // the cpu implementation does not need OpenGL at all
+    Pipeline pipeline;
+    GLuint texture = 0;
+    ThreadPool *pool = NULL;
+    bool persistent_upload = false;
+    int tile_size = options.tile; // larger images are blurred in tiles, 0 never on the cpu
+    if (!gpuType(type))
+    {
+        pool = new ThreadPool(options.threads);
+    }
+    else
+    {
+        initializeHeadless();
+        createPipeline(pipeline);
+        setPipelineKernel(pipeline, kernel);
+        persistent_upload = pipeline.upload_ring->persistent();
+
+        GLint max_texture_size = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+        tile_size = options.tile ? std::min(options.tile, int(max_texture_size)) : int(max_texture_size);
+    }
+
+    typedef std::chrono::steady_clock clock;
+    clock::time_point begin = clock::now();
+
+    // set before the decoders start, it is shared by all threads
+    stbi_set_flip_vertically_on_load(true);
+
+    // decoders run ahead of the GL thread and encoders behind it, the queues bound how far
+    const int workers = std::max(1, int(std::thread::hardware_concurrency()) / 2);
+    BoundedQueue<BatchImage> decoded(2 * workers);
+    BoundedQueue<BatchImage> blurred(2 * workers);
+
+    std::mutex stats_mutex;
+    double decode_ms = 0.0, encode_ms = 0.0;
+    int failed = 0;
+
+    std::atomic<size_t> next_input(0);
+    std::atomic<int> running_decoders(workers);
+    std::vector<std::thread> decoders;
+    for (int d = 0; d < workers; ++d)
+    {
+        decoders.push_back(std::thread([&]()
+        {
+            double ms = 0.0;
+            int errors = 0;
+            for (size_t i = next_input++; i < inputs.size(); i = next_input++)
+            {
+                clock::time_point start = clock::now();
+
+                BatchImage image;
+                image.input = inputs[i];
+                image.top_down = false;
+                std::string error;
+                if (options.reduce == 1 && mappedFormat(inputs[i].c_str()) != MAPPED_NONE)
+                {
+                    image.mapped = std::make_shared<MappedImage>();
+                    bool in_place = image.mapped->open(inputs[i].c_str()) && image.mapped->rgb8() && (!options.psf || !image.mapped->topDown());
+                    if (in_place)
+                    {
+                        image.pixels = image.mapped->pixels();
+                        image.width = image.mapped->width();
+                        image.height = image.mapped->height();
+                        image.top_down = image.mapped->topDown();
+                    }
+                    else
+                    {
+                        image.mapped.reset();
+                    }
+                }
+                if (!image.mapped)
+                {
+                    image.pixels = readImage(inputs[i].c_str(), image.width, image.height, options.reduce, error);
+                }
+                if (!image.pixels)
+                {
+                    std::cerr << inputs[i] << ": " << error << std::endl;
+                    ++errors;
+                    continue;
+                }
+
+                ms += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+                decoded.push(std::move(image));
+            }
+
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            decode_ms += ms;
+            failed += errors;
+            if (--running_decoders == 0)
+            {
+                decoded.close();
+            }
+        }));
+    }
+
+    std::vector<std::thread> encoders;
+    for (int e = 0; e < workers; ++e)
+    {
+        encoders.push_back(std::thread([&]()
+        {
+            double ms = 0.0;
+            int errors = 0;
+            BatchImage image;
+            while (blurred.pop(image))
+            {
+                clock::time_point start = clock::now();
+                if (!writeImage(batchOutput(options.output_file, image.input).c_str(), image.result.data(), image.width, image.height, 3, !image.top_down, encodeOptions(options, NULL)))
+                {
+                    ++errors;
+                }
+                ms += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+            }
+
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            encode_ms += ms;
+            failed += errors;
+        }));
+    }
+
+    // the GL thread only uploads, blurs and reads back
+    // readbacks stay in flight while the next image is blurred, the oldest is picked up when the ring is full
+    std::deque<BatchImage> in_flight;
+    const size_t max_in_flight = READBACK_SLOTS - 1;
+    auto finishOldest = [&]()
+    {
+        BatchImage &image = in_flight.front();
+        image.result.resize(size_t(image.width) * image.height * 3);
+        pipeline.readback_ring->finish(image.slot, image.result.data());
+        if (options.output_file)
+        {
+            blurred.push(std::move(image));
+        }
+        in_flight.pop_front();
+    };
+
+    double blur_ms = 0.0, wait_ms = 0.0;
+    int done = 0;
+    for (;;)
+    {
+        clock::time_point start = clock::now();
+
+        BatchImage image;
+        if (!decoded.pop(image))
+        {
+            break;
+        }
+
+        clock::time_point popped = clock::now();
+
+        // large images are blurred in tiles right away, like on the cpu
+        const bool tiled = tile_size && (image.width > tile_size || image.height > tile_size);
+        const bool synchronous = !gpuType(type) || tiled;
+        if (tiled)
+        {
+            std::vector<Tile> tiles = imageTiles(type, kernel, image.width, image.height, tile_size);
+            image.result.resize(size_t(image.width) * image.height * 3);
+            if (gpuType(type))
+            {
+                // keeps the results in flight in order
+                while (!in_flight.empty())
+                {
+                    finishOldest();
+                }
+                gpuBlurTiles(pipeline, texture, type, tiles, image.pixels, image.result.data(), image.width);
+            }
+            else
+            {
+                cpuBlurTiles(type, tiles, image.pixels, image.result.data(), image.width, kernel, *pool);
+            }
+        }
+        else if (!gpuType(type))
+        {
+            image.result.resize(size_t(image.width) * image.height * 3);
+            cpuBlur(type, image.pixels, image.result.data(), image.width, image.height, 3, kernel, *pool);
+        }
+        else
+        {
+            // the readback buffers can only grow when nothing is read into them
+            if (!pipeline.readback_ring->fits(image.width, image.height))
+            {
+                while (!in_flight.empty())
+                {
+                    finishOldest();
+                }
+            }
+
+            uploadImage(pipeline, texture, image.pixels, image.width, image.height);
+            blur(pipeline, type, texture, pipeline.FBO2);
+            image.slot = pipeline.readback_ring->start(pipeline.FBO2, image.width, image.height);
+        }
+        if (!image.mapped)
+        {
+            free(image.pixels);
+        }
+        image.mapped.reset();
+        image.pixels = NULL;
+
+        if (synchronous)
+        {
+            if (options.output_file)
+            {
+                blurred.push(std::move(image));
+            }
+        }
+        else
+        {
+            in_flight.push_back(std::move(image));
+            if (in_flight.size() > max_in_flight)
+            {
+                finishOldest();
+            }
+        }
+
+        clock::time_point finished = clock::now();
+        wait_ms += std::chrono::duration<double, std::milli>(popped - start).count();
+        blur_ms += std::chrono::duration<double, std::milli>(finished - popped).count();
+        ++done;
+    }
+
+    while (!in_flight.empty())
+    {
+        finishOldest();
+    }
+
+    blurred.close();
+    for (int i = 0; i < workers; ++i)
+    {
+        decoders[i].join();
+        encoders[i].join();
+    }
+    const double total_ms = std::chrono::duration<double, std::milli>(clock::now() - begin).count();
+
+    if (!gpuType(type))
+    {
+        delete pool;
+    }
+    else
+    {
+        glDeleteTextures(1, &texture);
+        deletePipeline(pipeline);
+        terminateHeadless();
+    }
+
+    std::cout << done << " images";
+    if (failed)
+    {
+        std::cout << ", " << failed << " failed";
+    }
+    std::cout << " in " << total_ms << " ms (" << done / (total_ms / 1000.0) << " images/s), "
+              << workers << " decode and " << workers << " encode threads" << std::endl;
+    if (done)
+    {
+        std::cout << "per image: decode " << decode_ms / done << " ms, "
+                  << (!gpuType(type) ? "blur " : "upload + blur + readback ") << blur_ms / done << " ms, "
+                  << "encode " << encode_ms / done << " ms, "
+                  << (!gpuType(type) ? "blur" : "GL") << " thread waiting for input " << wait_ms / done << " ms" << std::endl;
+    }
+    if (gpuType(type))
+    {
+        std::cout << "uploads and readbacks through " << (persistent_upload ? "persistently mapped buffers" : "mapped buffers") << std::endl;
+    }
+
+    return failed ? 1 : 0;
+}
+
+// a frame on its way through video mode, the frames are allocated once and go around
+struct VideoFrame
+{
+    std::vector<unsigned char> pixels; // top-down, they are blurred as they are
+    std::vector<unsigned char> result;
+    int slot; // readback ring slot the result is read into
+};
+
+// frames of video mode, enough for the queues between the threads and the readbacks in flight
+const int VIDEO_FRAMES = 8;
+
+// blurs a stream of frames from stdin to stdout with one context
+// reading and writing run on their own threads, the GL thread uploads a frame while earlier ones are read back
+int runVideo(const Options &options, const std::vector<const char*> &args)
+{
+    if (args.size() != 1)
+    {
+        std::cerr << "Wrong usage. ";
+        printUsage();
+        exit(-1);
+    }
+
+    int type = atoi(args[0]);
+    if (!validType(type))
+    {
+        std::cerr << "Invalid implementation type. Please choose between 1-" << IMPLEMENTATION_COUNT << "." << std::endl;
+        exit(-1);
+    }
+
+    Kernel kernel = optionKernel(options);
+    if (radiusLimited(type) && kernel.radius > MAX_RADIUS)
+    {
+        std::cerr << "Radius " << kernel.radius << " is too large for the shaders, maximum is " << MAX_RADIUS << "." << std::endl;
+        exit(-1);
+    }
+    // kernel images are flipped like bottom-up images, frames are top-down
+    if (options.psf)
+    {
+        std::cerr << "--video blurs with the gaussian, a kernel image can not be used." << std::endl;
+        exit(-1);
+    }
+
+    VideoFormat format;
+    if (options.video_width)
+    {
+        format.width = options.video_width;
+        format.height = options.video_height;
+    }
+    else
+    {
+        std::string error;
+        if (!readVideoHeader(stdin, format, error))
+        {
+            std::cerr << "Failed to read the video: " << error << "." << std::endl;
+            exit(-1);
+        }
+    }
+    if (!writeVideoHeader(stdout, format))
+    {
+        std::cerr << "Failed to write the video." << std::endl;
+        exit(-1);
+    }
+    const int width = format.width, height = format.height;
+
+    // the cpu implementation does not need OpenGL at all
+    Pipeline pipeline;
+    GLuint texture = 0;
+    ThreadPool *pool = NULL;
+    std::vector<Tile> tiles;
+    if (!gpuType(type))
+    {
+        pool = new ThreadPool(options.threads);
+        if (options.tile && (width > options.tile || height > options.tile))
+        {
+            tiles = imageTiles(type, kernel, width, height, options.tile);
+        }
+    }
+    else
+    {
+        initializeHeadless();
+        createPipeline(pipeline);
+        setPipelineKernel(pipeline, kernel);
+
+        GLint max_texture_size = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+        const int tile_size = options.tile ? std::min(options.tile, int(max_texture_size)) : int(max_texture_size);
+        if (width > tile_size || height > tile_size)
+        {
+            tiles = imageTiles(type, kernel, width, height, tile_size);
+        }
+    }
+
+    typedef std::chrono::steady_clock clock;
+    clock::time_point begin = clock::now();
+
+    // the reader takes spare frames and the writer gives them back, so at most VIDEO_FRAMES are on their way
+    BoundedQueue<VideoFrame> spare(VIDEO_FRAMES);
+    BoundedQueue<VideoFrame> read(VIDEO_FRAMES);
+    BoundedQueue<VideoFrame> blurred(VIDEO_FRAMES);
+    for (int i = 0; i < VIDEO_FRAMES; ++i)
+    {
+        VideoFrame frame;
+        frame.pixels.resize(size_t(width) * height * 3);
+        frame.result.resize(frame.pixels.size());
+        spare.push(std::move(frame));
+    }
+
+    std::atomic<bool> write_failed(false);
+    bool read_failed = false; // a frame was cut short, set by the reader before it closes the queue
+    double read_ms = 0.0, write_ms = 0.0;
+    std::thread reader([&]()
+    {
+        std::vector<unsigned char> scratch;
+        VideoFrame frame;
+        while (!write_failed && spare.pop(frame))
+        {
+            clock::time_point start = clock::now();
+            const int status = readVideoFrame(stdin, format, frame.pixels.data(), scratch);
+            if (status != VIDEO_FRAME)
+            {
+                read_failed = status == VIDEO_BROKEN;
+                break;
+            }
+            read_ms += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+            read.push(std::move(frame));
+        }
+        read.close();
+    });
+
+    std::thread writer([&]()
+    {
+        std::vector<unsigned char> scratch;
+        VideoFrame frame;
+        while (blurred.pop(frame))
+        {
+            // after a failed write the frames are only passed on, so the other threads can finish
+            clock::time_point start = clock::now();
+            if (!write_failed && (!writeVideoFrame(stdout, format, frame.result.data(), scratch) || fflush(stdout) != 0))
+            {
+                write_failed = true;
+            }
+            write_ms += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+            spare.push(std::move(frame));
+        }
+    });
+
+    // readbacks stay in flight while the next frame is uploaded and blurred, the oldest is picked up when the ring is full
+    std::deque<VideoFrame> in_flight;
+    const size_t max_in_flight = READBACK_SLOTS - 1;
+    auto finishOldest = [&]()
+    {
+        VideoFrame &frame = in_flight.front();
+        pipeline.readback_ring->finish(frame.slot, frame.result.data());
+        blurred.push(std::move(frame));
+        in_flight.pop_front();
+    };
+
+    double blur_ms = 0.0, wait_ms = 0.0;
+    int done = 0;
+    for (;;)
+    {
+        clock::time_point start = clock::now();
+
+        VideoFrame frame;
+        if (!read.pop(frame))
+        {
+            break;
+        }
+
+        clock::time_point popped = clock::now();
+
+        if (!tiles.empty())
+        {
+            if (gpuType(type))
+            {
+                gpuBlurTiles(pipeline, texture, type, tiles, frame.pixels.data(), frame.result.data(), width);
+            }
+            else
+            {
+                cpuBlurTiles(type, tiles, frame.pixels.data(), frame.result.data(), width, kernel, *pool);
+            }
+            blurred.push(std::move(frame));
+        }
+        else if (!gpuType(type))
+        {
+            cpuBlur(type, frame.pixels.data(), frame.result.data(), width, height, 3, kernel, *pool);
+            blurred.push(std::move(frame));
+        }
+        else
+        {
+            uploadImage(pipeline, texture, frame.pixels.data(), width, height);
+            blur(pipeline, type, texture, pipeline.FBO2);
+            frame.slot = pipeline.readback_ring->start(pipeline.FBO2, width, height);
+            in_flight.push_back(std::move(frame));
+            if (in_flight.size() > max_in_flight)
+            {
+                finishOldest();
+            }
+        }
+
+        clock::time_point finished = clock::now();
+        wait_ms += std::chrono::duration<double, std::milli>(popped - start).count();
+        blur_ms += std::chrono::duration<double, std::milli>(finished - popped).count();
+        ++done;
+    }
+
+    while (!in_flight.empty())
+    {
+        finishOldest();
+    }
+
+    blurred.close();
+    reader.join();
+    writer.join();
+    const double total_ms = std::chrono::duration<double, std::milli>(clock::now() - begin).count();
+
+    if (!gpuType(type))
+    {
+        delete pool;
+    }
+    else
+    {
+        glDeleteTextures(1, &texture);
+        deletePipeline(pipeline);
+        terminateHeadless();
+    }
+
+    // stdout carries the frames, so the statistics go to stderr
+    std::cerr << done << " frames of " << width << "x" << height << (format.y4m ? " Y4M" : " RGB") << " in " << total_ms << " ms ("
+              << done / (total_ms / 1000.0) << " fps)" << std::endl;
+    if (done)
+    {
+        std::cerr << "per frame: read " << read_ms / done << " ms, "
+                  << (!gpuType(type) ? "blur " : "upload + blur + readback ") << blur_ms / done << " ms, "
+                  << "write " << write_ms / done << " ms, "
+                  << (!gpuType(type) ? "blur" : "GL") << " thread waiting for frames " << wait_ms / done << " ms" << std::endl;
+    }
+    if (read_failed)
+    {
+        std::cerr << "Failed to read the video: frame " << done + 1 << " is cut short or does not start with FRAME." << std::endl;
+    }
+    if (write_failed)
+    {
+        std::cerr << "Failed to write the video." << std::endl;
+    }
+    return read_failed || write_failed ? -1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    options.headless = false;
+    options.output_file = NULL;
+    options.threads = 0;
+    options.timing = false;
+    options.repeat = 0;
+    options.sigma = 0.0f;
+    options.radius = 0;
+    options.boxes = DEFAULT_BOXES;
+    options.bench = false;
+    options.sizes = "256,512,1024,2048,4096,8192,16384";
+    options.sigmas = "2,5,10,20,40";
+    options.implementations = "1,2,3,4,5,6,7,8,9,10";
+    options.warmup = 2;
+    options.format = "csv";
+    options.verify = false;
+    options.min_psnr = 0.0;
+    options.batch = false;
+    options.stream = false;
+    options.video = false;
+    options.video_width = options.video_height = 0;
+    options.psf = NULL;
+    options.tile = 0;
+    options.reduce = 1;
+    options.quality = 95;
+    options.compression = 6;
+    std::vector<const char*> args;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--headless")
+        {
+            options.headless = true;
+        }
+        else if (arg == "--output" && i + 1 < argc)
+        {
+            options.output_file = argv[++i];
+        }
+        else if (arg == "--timing")
+        {
+            options.timing = true;
+        }
+        else if (arg == "--repeat" && i + 1 < argc)
+        {
+            options.repeat = std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            options.threads = atoi(argv[++i]);
+        }
+        else if (arg == "--sigma" && i + 1 < argc)
+        {
+            options.sigma = float(atof(argv[++i]));
+            if (options.sigma <= 0.0f)
+            {
+                std::cerr << "Invalid sigma. It has to be positive." << std::endl;
+                exit(-1);
+            }
+        }
+        else if (arg == "--radius" && i + 1 < argc)
+        {
+            options.radius = atoi(argv[++i]);
+            if (options.radius < 1)
+            {
+                std::cerr << "Invalid radius. It has to be at least 1." << std::endl;
+                exit(-1);
+            }
+        }
+        else if (arg == "--boxes" && i + 1 < argc)
+        {
+            options.boxes = atoi(argv[++i]);
+            if (options.boxes < 1)
+            {
+                std::cerr << "Invalid number of boxes. It has to be at least 1." << std::endl;
+                exit(-1);
+            }
+        }
+        else if (arg == "--tile" && i + 1 < argc)
+        {
+            options.tile = atoi(argv[++i]);
+            if (options.tile < 1)
+            {
+                std::cerr << "Invalid tile size. It has to be at least 1." << std::endl;
+                exit(-1);
+            }
+        }
+        else if (arg == "--quality" && i + 1 < argc)
+        {
+            options.quality = atoi(argv[++i]);
+            if (options.quality < 1 || options.quality > 100)
+            {
+                std::cerr << "Invalid JPEG quality. It has to be between 1 and 100." << std::endl;
+                exit(-1);
+            }
+        }
+        else if (arg == "--compression" && i + 1 < argc)
+        {
+            options.compression = atoi(argv[++i]);
+            if (options.compression < 0 || options.compression > 9)
+            {
+                std::cerr << "Invalid compression level. It has to be between 0 and 9." << std::endl;
+                exit(-1);
+            }
+        }
+        else if (arg == "--reduce" && i + 1 < argc)
+        {
+            options.reduce = atoi(argv[++i]);
+            if (options.reduce != 1 && options.reduce != 2 && options.reduce != 4 && options.reduce != 8)
+            {
+                std::cerr << "Invalid reduction. It has to be 1, 2, 4 or 8." << std::endl;
+                exit(-1);
+            }
+        }
+        else if (arg == "--psf" && i + 1 < argc)
+        {
+            options.psf = argv[++i];
+        }
+        else if (arg == "--bench")
+        {
+            options.bench = true;
+        }
+        else if (arg == "--verify")
+        {
+            options.verify = true;
+        }
+        else if (arg == "--stream")
+        {
+            options.stream = true;
+        }
+        else if (arg == "--batch")
+        {
+            options.batch = true;
+        }
+        else if (arg == "--video")
+        {
+            options.video = true;
+        }
+        else if (arg == "--video-size" && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%dx%d", &options.video_width, &options.video_height) != 2 || options.video_width < 1 || options.video_height < 1)
+            {
+                std::cerr << "Invalid video size. It has to be <width>x<height>." << std::endl;
+                exit(-1);
+            }
+        }
+        else if (arg == "--min-psnr" && i + 1 < argc)
+        {
+            options.min_psnr = atof(argv[++i]);
+        }
+        else if (arg == "--sizes" && i + 1 < argc)
+        {
+            options.sizes = argv[++i];
+        }
+        else if (arg == "--sigmas" && i + 1 < argc)
+        {
+            options.sigmas = argv[++i];
+        }
+        else if (arg == "--types" && i + 1 < argc)
+        {
+            options.implementations = argv[++i];
+        }
+        else if (arg == "--warmup" && i + 1 < argc)
+        {
+            options.warmup = std::max(0, atoi(argv[++i]));
+        }
+        else if (arg == "--format" && i + 1 < argc)
+        {
+            options.format = argv[++i];
+        }
+        else if (arg.compare(0, 2, "--") == 0)
+        {
+            std::cerr << "Wrong usage. Unknown option: " << arg << std::endl;
+            printUsage();
+            exit(-1);
+        }
+        else
+        {
+            args.push_back(argv[i]);
+        }
+    }
+
+    if (options.psf && (options.bench || options.verify))
+    {
+        std::cerr << "--psf can not be used with --bench or --verify, they measure the gaussian." << std::endl;
+        exit(-1);
+    }
+
+    if (options.bench)
+    {
+        return runBenchmark(options);
+    }
+
+    if (options.verify)
+    {
+        return runVerification(options, args);
+    }
+
+    if (options.batch)
+    {
+        return runBatch(options, args);
+    }
+
+    if (options.video)
+    {
+        return runVideo(options, args);
+    }
+
+    if (args.size() < 2)
+    {
+        std::cerr << "Wrong usage. ";
+        printUsage();
+        exit(-1);
+    }
+    else if (args.size() > 2)
+    {
+        std::cerr << "Wrong usage. You have provided extra input." << std::endl;
+        printUsage();
+        exit(-1);
+    }
+
+    int type = atoi(args[1]);
+    if (!validType(type))
+    {
+        std::cerr << "Invalid implementation type. Please choose between 1-" << IMPLEMENTATION_COUNT << "." << std::endl;
+        exit(-1);
+    }
+
+    Kernel kernel = optionKernel(options);
+
+    if (radiusLimited(type) && kernel.radius > MAX_RADIUS)
+    {
+        std::cerr << "Radius " << kernel.radius << " is too large for the shaders, maximum is " << MAX_RADIUS << "." << std::endl;
+        exit(-1);
+    }
+    // the window can switch to the other implementations
+    if (options.psf && (!psfType(type) || !options.headless))
+    {
+        std::cerr << "A kernel image needs --headless and the fft implementation, type 4 or 10." << std::endl;
+        exit(-1);
+    }
+
+    if (options.stream)
+    {
+        return runStream(options, args[0], type, kernel);
+    }
+
+    const int repeat = options.repeat > 0 ? options.repeat : 1;
+
+    // the cpu implementation does not need OpenGL at all when nothing is shown, so it also works without a GPU
+    if (!gpuType(type) && options.headless)
+    {
+        // a kernel image is not symmetric, so it needs the rows bottom-up like the kernel
+        int width, height;
+        bool top_down;
+        MappedImage input, output;
+        unsigned char *owned;
+        const unsigned char *data = mapInput(args[0], options.reduce, !options.psf, input, owned, width, height, top_down);
+
+        // the result goes straight into the output file when it can be mapped
+        std::vector<unsigned char> result;
+        unsigned char *target = mapOutput(options.output_file, width, height, top_down, output);
+        if (!target)
+        {
+            result.resize(size_t(width) * height * 3);
+            target = result.data();
+        }
+
+        std::vector<Tile> tiles;
+        if (options.tile && (width > options.tile || height > options.tile))
+        {
+            tiles = imageTiles(type, kernel, width, height, options.tile);
+            std::cout << tiles.size() << " tiles with an apron of " << blurReach(type, kernel) << " pixels" << std::endl;
+        }
+
+        ThreadPool pool(options.threads);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repeat; ++i)
+        {
+            if (tiles.empty())
+            {
+                cpuBlur(type, data, target, width, height, 3, kernel, pool);
+            }
+            else
+            {
+                cpuBlurTiles(type, tiles, data, target, width, kernel, pool);
+            }
+        }
+        std::chrono::steady_clock::time_point blurred = std::chrono::steady_clock::now();
+        free(owned);
+
+        double ms = std::chrono::duration<double, std::milli>(blurred - start).count() / repeat;
+        std::cout << "blur: " << ms << " ms, " << double(width) * height / (ms * 1000.0) << " MP/s on "
+                  << pool.size() << " threads (" << cpuKernels().name << ")" << std::endl;
+
+        return writeResult(options.output_file, output, result, width, height, top_down, encodeOptions(options, &pool)) ? 0 : -1;
+    }
+
+    if (options.headless)
+    {
+        initializeHeadless();
+    }
+    else
+    {
+        initialize(window_width, window_height, "Gaussian Blur");
+    }
+
+    Pipeline pipeline;
+    createPipeline(pipeline);
+
+    GLuint texture = 0;
+    int width, height;
+    imageSize(args[0], width, height, options.reduce);
+
+    // images larger than a texture are blurred in tiles, which the window can not show
+    GLint max_texture_size = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+    const int tile_size = options.tile ? std::min(options.tile, int(max_texture_size)) : int(max_texture_size);
+    if (width > tile_size || height > tile_size)
+    {
+        if (!options.headless)
+        {
+            std::cerr << "The image is larger than " << tile_size << " pixels, it can only be blurred in tiles with --headless." << std::endl;
+            exit(-1);
+        }
+
+        std::vector<Tile> tiles = imageTiles(type, kernel, width, height, tile_size);
+        std::cout << tiles.size() << " tiles with an apron of " << blurReach(type, kernel) << " pixels" << std::endl;
+        setPipelineKernel(pipeline, kernel);
+
+        bool top_down;
+        MappedImage input, output;
+        unsigned char *owned;
+        const unsigned char *data = mapInput(args[0], options.reduce, true, input, owned, width, height, top_down);
+        std::vector<unsigned char> pixels;
+        unsigned char *target = mapOutput(options.output_file, width, height, top_down, output);
+        if (!target)
+        {
+            pixels.resize(size_t(width) * height * 3);
+            target = pixels.data();
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repeat; ++i)
+        {
+            gpuBlurTiles(pipeline, texture, type, tiles, data, target, width);
+        }
+        std::chrono::steady_clock::time_point blurred = std::chrono::steady_clock::now();
+        free(owned);
+
+        std::cout << "blur: " << std::chrono::duration<double, std::milli>(blurred - start).count() / repeat << " ms with upload and readback" << std::endl;
+
+        ThreadPool encoders(options.threads);
+        int status = writeResult(options.output_file, output, pixels, width, height, top_down, encodeOptions(options, &encoders)) ? 0 : -1;
+
+        glDeleteTextures(1, &texture);
+        deletePipeline(pipeline);
+        terminateHeadless();
+        return status;
+    }
+
+    // headless results are read back in the row order of the input, so mapped files are used as they are
+    bool top_down = false;
+    if (options.headless && mappedFormat(args[0]) != MAPPED_NONE)
+    {
+        MappedImage input;
+        unsigned char *owned;
+        const unsigned char *data = mapInput(args[0], options.reduce, true, input, owned, width, height, top_down);
+        uploadImage(pipeline, texture, data, width, height);
+        free(owned);
+    }
+    else
+    {
+        uploadFile(pipeline, texture, args[0], options.reduce);
+    }
+
+    window_height = texture_height;
+    window_width = texture_width;
+    if (!options.headless)
+    {
+        glfwSetWindowSize(win, window_width, window_height);
+    }
+
+    setPipelineKernel(pipeline, kernel);
+
+    if (options.timing)
+    {
+        // repeated headless runs do not count the first one
+        gpu_timer = new GpuTimer(options.headless && repeat > 1 ? 1 : 0);
+    }
+
+    if (options.headless)
+    {
+        // there is no default framebuffer, so the result goes to FBO2
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < repeat; ++i)
+        {
+            blur(pipeline, type, texture, pipeline.FBO2);
+
+            if (gpu_timer)
+            {
+                gpu_timer->collect();
+            }
+        }
+        glFinish();
+
+        std::chrono::steady_clock::time_point blurred = std::chrono::steady_clock::now();
+
+        MappedImage output;
+        std::vector<unsigned char> pixels;
+        unsigned char *target = mapOutput(options.output_file, texture_width, texture_height, top_down, output);
+        if (!target)
+        {
+            pixels.resize(size_t(texture_width) * texture_height * 3);
+            target = pixels.data();
+        }
+        readResult(pipeline, target);
+
+        std::chrono::steady_clock::time_point read = std::chrono::steady_clock::now();
+
+        std::cout << "blur: " << std::chrono::duration<double, std::milli>(blurred - start).count() / repeat << " ms, "
+                  << "readback: " << std::chrono::duration<double, std::milli>(read - blurred).count() << " ms" << std::endl;
+
+        if (gpu_timer)
+        {
+            gpu_timer->finish();
+            gpu_timer->report(std::cout);
+            delete gpu_timer;
+        }
+
+        ThreadPool encoders(options.threads);
+        int status = writeResult(options.output_file, output, pixels, texture_width, texture_height, top_down, encodeOptions(options, &encoders)) ? 0 : -1;
+
+        glDeleteTextures(1, &texture);
+        deletePipeline(pipeline);
+
+        terminateHeadless();
+        return status;
+    }
+
+    // the result is computed once into FBO2 and only copied to the window afterwards
+    blur_type = type;
+    blur_sigma = kernel.sigma;
+    ThreadPool *pool = NULL;
+    std::vector<unsigned char> source, result;
+    std::vector<unsigned char> saved;
+    std::thread saver;
+
+    while(!glfwWindowShouldClose(win))
+    {
+        if (reload_input)
+        {
+            int width, height;
+            imageSize(args[0], width, height, options.reduce);
+            if (width == texture_width && height == texture_height)
+            {
+                uploadFile(pipeline, texture, args[0], options.reduce);
+                source.clear();
+            }
+            else
+            {
+                std::cerr << "Input image changed its size, it is not reloaded." << std::endl;
+            }
+            reload_input = false;
+        }
+
+        if (result_dirty)
+        {
+            if (blur_sigma != kernel.sigma)
+            {
+                kernel = createKernel(blur_sigma, options.radius, options.boxes);
+                setPipelineKernel(pipeline, kernel);
+            }
+
+            if (gpuType(blur_type) && unsupported(pipeline, blur_type, kernel))
+            {
+                std::cerr << implementationName(blur_type) << ": " << unsupported(pipeline, blur_type, kernel) << ", staying on the cpu." << std::endl;
+                blur_type = 4;
+            }
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            if (!gpuType(blur_type))
+            {
+                // source pixels are kept on the cpu while the image does not change
+                if (source.empty())
+                {
+                    int width, height;
+                    unsigned char *data = loadImage(args[0], width, height, options.reduce);
+                    source.assign(data, data + size_t(width) * height * 3);
+                    result.resize(source.size());
+                    free(data);
+                }
+                if (!pool)
+                {
+                    pool = new ThreadPool(options.threads);
+                }
+                cpuBlur(blur_type, source.data(), result.data(), texture_width, texture_height, 3, kernel, *pool);
+
+                glBindTexture(GL_TEXTURE_2D, pipeline.filtered_texture);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texture_width, texture_height, GL_RGB, GL_UNSIGNED_BYTE, result.data());
+            }
+            else
+            {
+                blur(pipeline, blur_type, texture, pipeline.FBO2);
+            }
+            glFinish();
+
+            std::chrono::steady_clock::time_point blurred = std::chrono::steady_clock::now();
+            std::cout << "type " << blur_type << ", sigma " << kernel.sigma << ", radius " << kernel.radius << ": "
+                      << std::chrono::duration<double, std::milli>(blurred - start).count() << " ms" << std::endl;
+
+            result_dirty = false;
+        }
+
+        if (save_result && !options.output_file)
+        {
+            std::cerr << "Start with --output <file> to save the result." << std::endl;
+        }
+        else if (save_result)
+        {
+            // only the readback runs here, the result is encoded on another thread while the window goes on
+            if (saver.joinable())
+            {
+                saver.join();
+            }
+            saved.resize(size_t(texture_width) * texture_height * 3);
+            readResult(pipeline, saved.data());
+            const int width = texture_width, height = texture_height;
+            saver = std::thread([&options, &saved, width, height]()
+            {
+                ThreadPool encoders(options.threads);
+                if (writeImage(options.output_file, saved.data(), width, height, 3, true, encodeOptions(options, &encoders)))
+                {
+                    std::cout << "saved " << options.output_file << std::endl;
+                }
+            });
+        }
+        save_result = false;
+
+        if (gpu_timer)
+        {
+            gpu_timer->collect();
+        }
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, pipeline.FBO2);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, texture_width, texture_height, 0, 0, window_width, window_height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        glfwSwapBuffers(win);
+        // sleeps until there is input, nothing is drawn while the result stays the same
+        glfwWaitEvents();
+    }
+
+    delete pool;
+    if (saver.joinable())
+    {
+        saver.join();
+    }
+
+    if (gpu_timer)
+    {
+        gpu_timer->finish();
+        gpu_timer->report(std::cout);
+        delete gpu_timer;
     }
 
-    // Cleanup VBO
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-    // Cleanup FBOs
-    glDeleteBuffers(1, &FBO1);
-    glDeleteBuffers(1, &FBO2);
-    // Cleanup textures
     glDeleteTextures(1, &texture);
-    glDeleteTextures(1, &intermediate_texture);
-    glDeleteTextures(1, &filtered_texture);
+    deletePipeline(pipeline);
 
     glfwTerminate();
     return 0;
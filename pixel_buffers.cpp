@@ -0,0 +1,335 @@
+#include "pixel_buffers.h"
+
+#include <cstring>
+#include <algorithm>
+
+// slots start at multiples of this, plenty for any pixel transfer
+static const size_t SLOT_ALIGNMENT = 256;
+
+// largest upload slot, three of them for a 16384 x 16384 image would be 2.4 GB of mapped memory
+static const size_t MAX_SLOT_BYTES = 64 << 20;
+
+// true if the buffer allocation just issued ran out of memory, clears all pending errors
+static bool outOfMemory()
+{
+    bool failed = false;
+    for (GLenum error = glGetError(); error != GL_NO_ERROR; error = glGetError())
+    {
+        failed = failed || error == GL_OUT_OF_MEMORY;
+    }
+    return failed;
+}
+
+// waits for the gpu to finish reading or writing a slot
+static void waitFence(GLsync &fence)
+{
+    if (fence)
+    {
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(-1));
+        glDeleteSync(fence);
+        fence = 0;
+    }
+}
+
+UploadRing::UploadRing(int slots) : slots(slots), current(0), slot_size(0), failed_size(size_t(-1)), mapped(NULL),
+    mapped_slot(0), mapped_width(0), mapped_rows(0), mapped_client(false)
+{
+    persistent_mapping = GLEW_ARB_buffer_storage || GLEW_VERSION_4_4;
+    fences.assign(slots, 0);
+}
+
+UploadRing::~UploadRing()
+{
+    release();
+}
+
+bool UploadRing::persistent() const
+{
+    return persistent_mapping;
+}
+
+void UploadRing::release()
+{
+    for (int i = 0; i < slots; ++i)
+    {
+        waitFence(fences[i]);
+    }
+    if (mapped)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[0]);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        mapped = NULL;
+    }
+    if (!buffers.empty())
+    {
+        glDeleteBuffers(GLsizei(buffers.size()), buffers.data());
+        buffers.clear();
+    }
+    slot_size = 0;
+}
+
+// buffers only grow, like the framebuffer textures
+// if they can not be allocated or mapped there are none and sizes from size on are not tried again
+void UploadRing::allocate(size_t size)
+{
+    release();
+    slot_size = (size + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+
+    outOfMemory();
+    if (persistent_mapping)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        buffers.resize(1);
+        glGenBuffers(1, buffers.data());
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[0]);
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, slot_size * slots, NULL, flags);
+        mapped = outOfMemory() ? NULL : (unsigned char*) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, slot_size * slots, flags);
+    }
+    else
+    {
+        buffers.resize(slots);
+        glGenBuffers(slots, buffers.data());
+        for (int i = 0; i < slots; ++i)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[i]);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, slot_size, NULL, GL_STREAM_DRAW);
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if ((persistent_mapping && !mapped) || outOfMemory())
+    {
+        release();
+        failed_size = size;
+    }
+}
+
+int UploadRing::bandRows(int width) const
+{
+    return int(std::max<size_t>(1, MAX_SLOT_BYTES / (size_t(width) * 3)));
+}
+
+void UploadRing::upload(GLuint texture, const unsigned char *data, int width, int height)
+{
+    const size_t stride = size_t(width) * 3;
+    const int band = bandRows(width);
+    for (int y = 0; y < height; y += band)
+    {
+        const int rows = std::min(band, height - y);
+        memcpy(map(width, rows), data + y * stride, rows * stride);
+        commit(texture, y);
+    }
+}
+
+unsigned char *UploadRing::map(int width, int rows)
+{
+    const size_t size = size_t(width) * rows * 3;
+    if (size > slot_size && size < failed_size)
+    {
+        allocate(size);
+    }
+
+    mapped_slot = current;
+    mapped_width = width;
+    mapped_rows = rows;
+    mapped_client = false;
+    current = (current + 1) % slots;
+
+    unsigned char *pointer = NULL;
+    if (size <= slot_size && persistent_mapping)
+    {
+        // the slot may still be read by the upload of slots bands ago
+        waitFence(fences[mapped_slot]);
+        pointer = mapped + mapped_slot * slot_size;
+    }
+    else if (size <= slot_size)
+    {
+        // invalidating lets the driver hand out fresh storage instead of waiting for the last transfer
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[mapped_slot]);
+        pointer = (unsigned char*) glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    if (!pointer)
+    {
+        // no buffer, commit uploads the band from client memory and returns after the copy
+        client.resize(size);
+        mapped_client = true;
+        pointer = client.data();
+    }
+    return pointer;
+}
+
+void UploadRing::commit(GLuint texture, int y)
+{
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (mapped_client)
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, mapped_width, mapped_rows, GL_RGB, GL_UNSIGNED_BYTE, client.data());
+        return;
+    }
+
+    size_t offset = 0;
+    if (persistent_mapping)
+    {
+        offset = mapped_slot * slot_size;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[0]);
+    }
+    else
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[mapped_slot]);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, mapped_width, mapped_rows, GL_RGB, GL_UNSIGNED_BYTE, (const void*) offset);
+
+    if (persistent_mapping)
+    {
+        fences[mapped_slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+ReadbackRing::ReadbackRing(int slots) : slots(slots), current(0), slot_size(0), failed_size(size_t(-1)), mapped(NULL)
+{
+    persistent_mapping = GLEW_ARB_buffer_storage || GLEW_VERSION_4_4;
+    fences.assign(slots, 0);
+    sizes.assign(slots, 0);
+    client.resize(slots);
+}
+
+ReadbackRing::~ReadbackRing()
+{
+    release();
+}
+
+bool ReadbackRing::persistent() const
+{
+    return persistent_mapping;
+}
+
+bool ReadbackRing::fits(int width, int height) const
+{
+    // sizes that failed to allocate are read without buffers, those need no room
+    const size_t size = size_t(width) * height * 3;
+    return size <= slot_size || size >= failed_size;
+}
+
+void ReadbackRing::release()
+{
+    for (int i = 0; i < slots; ++i)
+    {
+        waitFence(fences[i]);
+    }
+    if (mapped)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[0]);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        mapped = NULL;
+    }
+    if (!buffers.empty())
+    {
+        glDeleteBuffers(GLsizei(buffers.size()), buffers.data());
+        buffers.clear();
+    }
+    slot_size = 0;
+}
+
+// as for the upload ring, buffers that can not be allocated or mapped are released and not tried again
+void ReadbackRing::allocate(size_t size)
+{
+    release();
+    slot_size = (size + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+
+    outOfMemory();
+    if (persistent_mapping)
+    {
+        const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        buffers.resize(1);
+        glGenBuffers(1, buffers.data());
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[0]);
+        glBufferStorage(GL_PIXEL_PACK_BUFFER, slot_size * slots, NULL, flags);
+        mapped = outOfMemory() ? NULL : (unsigned char*) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot_size * slots, flags);
+    }
+    else
+    {
+        buffers.resize(slots);
+        glGenBuffers(slots, buffers.data());
+        for (int i = 0; i < slots; ++i)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, slot_size, NULL, GL_STREAM_READ);
+        }
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if ((persistent_mapping && !mapped) || outOfMemory())
+    {
+        release();
+        failed_size = size;
+    }
+}
+
+int ReadbackRing::start(GLuint framebuffer, int width, int height)
+{
+    const size_t size = size_t(width) * height * 3;
+    if (size > slot_size && size < failed_size)
+    {
+        allocate(size);
+    }
+
+    const int slot = current;
+    current = (current + 1) % slots;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    if (size > slot_size)
+    {
+        // no buffer, the pixels are read right away
+        client[slot].resize(size);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, client[slot].data());
+    }
+    else
+    {
+        client[slot].clear();
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, persistent_mapping ? buffers[0] : buffers[slot]);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, (void*) (persistent_mapping ? slot * slot_size : 0));
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    sizes[slot] = size;
+    return slot;
+}
+
+void ReadbackRing::finish(int slot, unsigned char *pixels)
+{
+    waitFence(fences[slot]);
+
+    if (!client[slot].empty())
+    {
+        memcpy(pixels, client[slot].data(), sizes[slot]);
+    }
+    else if (persistent_mapping)
+    {
+        // coherent mapping, the data is visible as soon as the fence signaled
+        memcpy(pixels, mapped + slot * slot_size, sizes[slot]);
+    }
+    else
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[slot]);
+        const void *pointer = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizes[slot], GL_MAP_READ_BIT);
+        if (pointer)
+        {
+            memcpy(pixels, pointer, sizes[slot]);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        else
+        {
+            glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, sizes[slot], pixels);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef __PIXEL_BUFFERS_H__
+#define __PIXEL_BUFFERS_H__
+
+#include <vector>
+#include <cstddef>
+
+#include <GL/glew.h>
+
+// uploads 8-bit RGB images through a ring of pixel unpack buffers
+// glTexSubImage2D then returns without copying and the transfer overlaps with the work already queued
+// with ARB_buffer_storage the ring is a single persistently mapped buffer and every slot is guarded by a fence,
+// otherwise every slot is its own buffer that is orphaned and mapped for each upload
+// slots hold at most MAX_SLOT_BYTES, larger images go through them in bands of rows
+// when the buffers can not be allocated or mapped the rows are uploaded from client memory instead
+class UploadRing
+{
+    public:
+        explicit UploadRing(int slots = 3);
+        ~UploadRing();
+
+        // copies the pixels into the next slots and starts the transfers into the lower left corner of texture
+        void upload(GLuint texture, const unsigned char *data, int width, int height);
+
+        // the same a band at a time, so a decoder can write the pixels (rows bottom-up) into the slot itself
+        // the band is rows x width pixels, at most bandRows(width) rows; the pointer is never NULL and only
+        // valid until commit, which starts the transfer into the rows from y up of texture
+        unsigned char *map(int width, int rows);
+        void commit(GLuint texture, int y);
+
+        // rows of width pixels a slot holds
+        int bandRows(int width) const;
+
+        bool persistent() const;
+
+    private:
+        int slots;
+        int current;
+        size_t slot_size;
+        size_t failed_size; // buffers this large could not be allocated, they are not tried again
+        bool persistent_mapping;
+        std::vector<GLuint> buffers; // one per slot, or a single one split into slots when persistently mapped
+        std::vector<GLsync> fences;
+        unsigned char *mapped;
+        int mapped_slot, mapped_width, mapped_rows; // of the band between map and commit
+        bool mapped_client; // the band is in client instead of a buffer
+        std::vector<unsigned char> client;
+
+        void allocate(size_t size);
+        void release();
+};
+
+// reads 8-bit RGB results back through a ring of pixel pack buffers
+// glReadPixels only queues the copy and a fence marks when it is done, so the cpu picks up the result of
+// one image while the gpu works on the next; the buffers are persistently mapped with ARB_buffer_storage
+// when the buffers can not be allocated start reads synchronously into client memory
+class ReadbackRing
+{
+    public:
+        explicit ReadbackRing(int slots = 3);
+        ~ReadbackRing();
+
+        // queues the copy of the lower left width x height pixels of framebuffer, returns the slot they go to
+        // at most slots reads can be in flight, each has to be finished before its slot comes around again
+        int start(GLuint framebuffer, int width, int height);
+
+        // waits for the copy into slot and writes the pixels (rows bottom-up) to pixels
+        // a buffer that can not be mapped is read with glGetBufferSubData
+        void finish(int slot, unsigned char *pixels);
+
+        // false when the buffers have to grow for an image, which needs all reads to be finished first
+        bool fits(int width, int height) const;
+
+        bool persistent() const;
+
+    private:
+        int slots;
+        int current;
+        size_t slot_size;
+        size_t failed_size; // buffers this large could not be allocated, they are not tried again
+        bool persistent_mapping;
+        std::vector<GLuint> buffers; // one per slot, or a single one split into slots when persistently mapped
+        std::vector<GLsync> fences;
+        std::vector<size_t> sizes; // bytes being read into every slot
+        std::vector<std::vector<unsigned char> > client; // pixels of the slots read without a buffer
+        unsigned char *mapped;
+
+        void allocate(size_t size);
+        void release();
+};
+
+#endif
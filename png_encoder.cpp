@@ -0,0 +1,260 @@
+#include "png_encoder.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+// deflate can reach back this far, so this much data before a chunk is its dictionary
+static const size_t DEFLATE_WINDOW = 32768;
+
+// bytes of filtered data a chunk should have at least, smaller chunks lose compression at every boundary
+static const size_t PNG_CHUNK_BYTES = 256 * 1024;
+
+static void storeBigEndian(unsigned char *target, uLong value)
+{
+    target[0] = (unsigned char) (value >> 24);
+    target[1] = (unsigned char) (value >> 16);
+    target[2] = (unsigned char) (value >> 8);
+    target[3] = (unsigned char) value;
+}
+
+static inline int paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc)
+    {
+        return a;
+    }
+    return pb <= pc ? b : c;
+}
+
+// writes the filter type and the filtered row to out, prior is the row above (zeros for the first)
+// the filter is chosen by the smallest sum of the filtered bytes taken as signed, the heuristic of libpng
+static void filterRow(const unsigned char *row, const unsigned char *prior, unsigned char *out, size_t bytes, int bpp)
+{
+    long sums[5] = {0, 0, 0, 0, 0};
+    for (size_t i = 0; i < bytes; ++i)
+    {
+        const int a = i >= size_t(bpp) ? row[i - bpp] : 0;
+        const int b = prior[i];
+        const int c = i >= size_t(bpp) ? prior[i - bpp] : 0;
+        const int x = row[i];
+        sums[0] += std::abs(int((signed char) x));
+        sums[1] += std::abs(int((signed char) (x - a)));
+        sums[2] += std::abs(int((signed char) (x - b)));
+        sums[3] += std::abs(int((signed char) (x - ((a + b) >> 1))));
+        sums[4] += std::abs(int((signed char) (x - paeth(a, b, c))));
+    }
+    const int filter = int(std::min_element(sums, sums + 5) - sums);
+
+    out[0] = (unsigned char) filter;
+    for (size_t i = 0; i < bytes; ++i)
+    {
+        const int a = i >= size_t(bpp) ? row[i - bpp] : 0;
+        const int b = prior[i];
+        const int c = i >= size_t(bpp) ? prior[i - bpp] : 0;
+        int predicted = 0;
+        switch (filter)
+        {
+            case 1: predicted = a; break;
+            case 2: predicted = b; break;
+            case 3: predicted = (a + b) >> 1; break;
+            case 4: predicted = paeth(a, b, c); break;
+        }
+        out[i + 1] = (unsigned char) (row[i] - predicted);
+    }
+}
+
+// deflates data without a zlib header into out, a sync flush ends the chunk on a byte boundary unless it is the last
+// false if zlib fails, the chunk is then not written at all
+static bool deflateChunk(const std::vector<unsigned char> &data, const unsigned char *dictionary, size_t dictionary_size,
+                         int level, bool last, std::vector<unsigned char> &out)
+{
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return false;
+    }
+    bool ok = !dictionary_size || deflateSetDictionary(&stream, dictionary, uInt(dictionary_size)) == Z_OK;
+
+    // the bound covers a finished stream, a sync flush adds an empty stored block of 5 bytes
+    out.resize(deflateBound(&stream, uLong(data.size())) + 16);
+    stream.next_in = const_cast<Bytef*>(data.data());
+    stream.avail_in = uInt(data.size());
+    stream.next_out = out.data();
+    stream.avail_out = uInt(out.size());
+    if (ok)
+    {
+        // all input has to be consumed, and a sync flush must not have filled the output
+        const int status = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+        ok = last ? status == Z_STREAM_END : status == Z_OK && stream.avail_in == 0 && stream.avail_out > 0;
+    }
+    out.resize(stream.total_out);
+    deflateEnd(&stream);
+    return ok;
+}
+
+PngEncoder::PngEncoder() : file(NULL), width(0), height(0), channels(0), level(6), pool(NULL), row_bytes(0),
+    chunk_rows(0), group_rows(0), pending_rows(0), rows_done(0), adler(0), ok(false)
+{
+}
+
+bool PngEncoder::writeChunk(const char *type, const unsigned char *data, size_t size)
+{
+    unsigned char length[4], crc[4];
+    storeBigEndian(length, uLong(size));
+    uLong sum = crc32(0L, (const Bytef*) type, 4);
+    if (size)
+    {
+        // a NULL buffer would reset the crc
+        sum = crc32(sum, data, uInt(size));
+    }
+    storeBigEndian(crc, sum);
+
+    return fwrite(length, 1, 4, file) == 4 && fwrite(type, 1, 4, file) == 4
+        && fwrite(data, 1, size, file) == size && fwrite(crc, 1, 4, file) == 4;
+}
+
+bool PngEncoder::start(FILE *target, int image_width, int image_height, int image_channels, int compression, ThreadPool *threads)
+{
+    file = target;
+    width = image_width;
+    height = image_height;
+    channels = image_channels;
+    level = std::min(std::max(compression, 0), 9);
+    pool = threads;
+    row_bytes = size_t(width) * channels;
+
+    const int threads_count = pool ? pool->size() : 1;
+    chunk_rows = int(std::max<size_t>(1, PNG_CHUNK_BYTES / (row_bytes + 1)));
+    group_rows = chunk_rows * threads_count;
+    pending.resize(size_t(group_rows) * row_bytes);
+    pending_rows = 0;
+    rows_done = 0;
+    previous.assign(row_bytes, 0);
+    window.clear();
+    adler = adler32(0L, Z_NULL, 0);
+
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    static const unsigned char color_types[5] = { 0, 0, 4, 2, 6 };
+    unsigned char header[13];
+    storeBigEndian(header, uLong(width));
+    storeBigEndian(header + 4, uLong(height));
+    header[8] = 8; // bits per sample
+    header[9] = color_types[channels];
+    header[10] = 0; // deflate
+    header[11] = 0; // adaptive filters
+    header[12] = 0; // not interlaced
+    ok = fwrite(signature, 1, 8, file) == 8 && writeChunk("IHDR", header, sizeof(header));
+    return ok;
+}
+
+bool PngEncoder::write(const unsigned char *rows, ptrdiff_t stride, int count)
+{
+    count = std::min(count, height - rows_done - pending_rows);
+    for (int i = 0; i < count && ok; ++i)
+    {
+        memcpy(pending.data() + size_t(pending_rows) * row_bytes, rows + i * stride, row_bytes);
+        if (++pending_rows == group_rows || rows_done + pending_rows == height)
+        {
+            flush();
+        }
+    }
+    return ok;
+}
+
+void PngEncoder::flush()
+{
+    const int chunks = (pending_rows + chunk_rows - 1) / chunk_rows;
+    const bool last = rows_done + pending_rows == height;
+    std::vector<std::vector<unsigned char> > filtered(chunks), compressed(chunks);
+    std::vector<char> deflated(chunks, 0);
+
+    // filters look at the row above, which is still in the group or the last row of the group before
+    std::function<void(int, int)> filter = [&](int begin, int end)
+    {
+        for (int c = begin; c < end; ++c)
+        {
+            const int first = c * chunk_rows;
+            const int rows = std::min(chunk_rows, pending_rows - first);
+            filtered[c].resize(size_t(rows) * (row_bytes + 1));
+            for (int r = 0; r < rows; ++r)
+            {
+                const unsigned char *row = pending.data() + size_t(first + r) * row_bytes;
+                const unsigned char *prior = first + r == 0 ? previous.data() : row - row_bytes;
+                filterRow(row, prior, filtered[c].data() + size_t(r) * (row_bytes + 1), row_bytes, channels);
+            }
+        }
+    };
+    // every chunk starts with the data before it as dictionary, so it compresses as if the stream went on
+    std::function<void(int, int)> compress = [&](int begin, int end)
+    {
+        for (int c = begin; c < end; ++c)
+        {
+            const std::vector<unsigned char> &before = c == 0 ? window : filtered[c - 1];
+            const size_t dictionary = std::min(before.size(), DEFLATE_WINDOW);
+            deflated[c] = deflateChunk(filtered[c], before.data() + before.size() - dictionary, dictionary, level, last && c == chunks - 1, compressed[c]);
+        }
+    };
+    if (pool)
+    {
+        pool->parallelFor(chunks, filter);
+        pool->parallelFor(chunks, compress);
+    }
+    else
+    {
+        filter(0, chunks);
+        compress(0, chunks);
+    }
+
+    // a chunk zlib failed on would leave a broken stream, nothing more is written then
+    for (int c = 0; c < chunks; ++c)
+    {
+        ok = ok && deflated[c];
+    }
+    for (int c = 0; c < chunks && ok; ++c)
+    {
+        std::vector<unsigned char> data;
+        if (rows_done == 0 && c == 0)
+        {
+            // zlib header: deflate with a 32 KB window, the level hint and the check bits
+            const int flevel = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+            const int cmf = 0x78, flg = flevel << 6;
+            data.push_back((unsigned char) cmf);
+            data.push_back((unsigned char) (flg + 31 - (cmf * 256 + flg) % 31));
+        }
+        data.insert(data.end(), compressed[c].begin(), compressed[c].end());
+
+        // the checksums of the chunks combine into the one of the whole stream
+        adler = adler32_combine(adler, adler32(adler32(0L, Z_NULL, 0), filtered[c].data(), uInt(filtered[c].size())), z_off_t(filtered[c].size()));
+        if (last && c == chunks - 1)
+        {
+            unsigned char sum[4];
+            storeBigEndian(sum, adler);
+            data.insert(data.end(), sum, sum + 4);
+        }
+        ok = writeChunk("IDAT", data.data(), data.size());
+
+        window.insert(window.end(), filtered[c].end() - std::min(filtered[c].size(), DEFLATE_WINDOW), filtered[c].end());
+        if (window.size() > DEFLATE_WINDOW)
+        {
+            window.erase(window.begin(), window.end() - DEFLATE_WINDOW);
+        }
+    }
+
+    memcpy(previous.data(), pending.data() + size_t(pending_rows - 1) * row_bytes, row_bytes);
+    rows_done += pending_rows;
+    pending_rows = 0;
+}
+
+bool PngEncoder::finish()
+{
+    ok = ok && rows_done == height;
+    if (ok)
+    {
+        ok = writeChunk("IEND", NULL, 0);
+    }
+    return ok;
+}
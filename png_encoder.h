@@ -0,0 +1,50 @@
+#ifndef __PNG_ENCODER_H__
+#define __PNG_ENCODER_H__
+
+#include <cstdio>
+#include <cstddef>
+#include <vector>
+
+#include <zlib.h>
+
+#include "thread_pool.h"
+
+// PNG encoder that filters and deflates chunks of rows in parallel (like pigz)
+// every chunk is deflated on its own with the 32 KB of data before it as dictionary and ends on a byte
+// boundary, so the chunks put together are a single zlib stream about as small as one deflated at once
+// rows are collected until there is a chunk for every thread, only those are in memory
+class PngEncoder
+{
+    public:
+        PngEncoder();
+
+        // writes the signature and the header, channels 1 (gray), 2 (gray and alpha), 3 (RGB) or 4 (RGBA)
+        // level is the zlib compression level 0-9, without a pool everything runs on the calling thread
+        bool start(FILE *file, int width, int height, int channels, int level, ThreadPool *pool);
+
+        // adds the next count rows (top-down), stride bytes apart
+        bool write(const unsigned char *rows, ptrdiff_t stride, int count);
+
+        // writes the rest of the image data and the end of the file, false if rows are missing or a write failed
+        bool finish();
+
+    private:
+        FILE *file;
+        int width, height, channels, level;
+        ThreadPool *pool;
+        size_t row_bytes;
+        int chunk_rows; // rows deflated by one thread
+        int group_rows; // rows collected before the chunks are deflated
+        std::vector<unsigned char> pending; // rows of the group
+        int pending_rows;
+        int rows_done;
+        std::vector<unsigned char> previous; // last row of the group before, filters look at it
+        std::vector<unsigned char> window; // last 32 KB of filtered data, the dictionary of the next chunk
+        uLong adler; // checksum of all filtered data so far
+        bool ok;
+
+        void flush();
+        bool writeChunk(const char *type, const unsigned char *data, size_t size);
+};
+
+#endif
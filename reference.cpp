@@ -0,0 +1,88 @@
+#include "reference.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+std::vector<double> referenceBlur(const unsigned char *src, int width, int height, int channels, const Kernel &kernel, ThreadPool &pool)
+{
+    const int M = kernel.radius;
+    const std::vector<double> weights = exactWeights(kernel.sigma, M);
+    const size_t stride = size_t(width) * channels;
+
+    std::vector<double> intermediate(stride * height);
+    std::vector<double> result(stride * height);
+
+    // horizontal
+    pool.parallelFor(height, [&](int begin, int end)
+    {
+        for (int y = begin; y < end; ++y)
+        {
+            const unsigned char *row = src + y * stride;
+            for (int x = 0; x < width; ++x)
+            {
+                for (int c = 0; c < channels; ++c)
+                {
+                    double sum = 0.0;
+                    for (int i = -M; i <= M; ++i)
+                    {
+                        int sx = std::min(std::max(x + i, 0), width - 1);
+                        sum += weights[std::abs(i)] * row[sx * channels + c];
+                    }
+                    intermediate[y * stride + x * channels + c] = sum;
+                }
+            }
+        }
+    });
+
+    // vertical
+    pool.parallelFor(height, [&](int begin, int end)
+    {
+        for (int y = begin; y < end; ++y)
+        {
+            for (size_t x = 0; x < stride; ++x)
+            {
+                double sum = 0.0;
+                for (int i = -M; i <= M; ++i)
+                {
+                    int sy = std::min(std::max(y + i, 0), height - 1);
+                    sum += weights[std::abs(i)] * intermediate[sy * stride + x];
+                }
+                result[y * stride + x] = sum;
+            }
+        }
+    });
+
+    return result;
+}
+
+ImageError compareImages(const unsigned char *image, const std::vector<double> &reference, int width, int height, int channels)
+{
+    ImageError error;
+    error.max_error = 0.0;
+    error.channel_max.assign(channels, 0.0);
+    error.channel_rmse.assign(channels, 0.0);
+
+    const size_t pixels = size_t(width) * height;
+    double total = 0.0;
+    for (size_t i = 0; i < pixels; ++i)
+    {
+        for (int c = 0; c < channels; ++c)
+        {
+            double diff = std::fabs(double(image[i * channels + c]) - reference[i * channels + c]);
+            error.channel_max[c] = std::max(error.channel_max[c], diff);
+            error.channel_rmse[c] += diff * diff;
+            total += diff * diff;
+        }
+    }
+
+    for (int c = 0; c < channels; ++c)
+    {
+        error.max_error = std::max(error.max_error, error.channel_max[c]);
+        error.channel_rmse[c] = std::sqrt(error.channel_rmse[c] / pixels);
+    }
+
+    double mse = total / (pixels * channels);
+    error.psnr = mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : std::numeric_limits<double>::infinity();
+    return error;
+}
@@ -0,0 +1,25 @@
+#ifndef __REFERENCE_H__
+#define __REFERENCE_H__
+
+#include <vector>
+
+#include "kernel.h"
+#include "thread_pool.h"
+
+// golden image: separable gaussian in double precision without any rounding
+// uses the exact weights of the kernel and clamps the edges like every implementation
+std::vector<double> referenceBlur(const unsigned char *src, int width, int height, int channels, const Kernel &kernel, ThreadPool &pool);
+
+// error of an 8-bit result against the golden image, in 8-bit units
+struct ImageError
+{
+    double psnr; // dB over all channels, infinite for identical images
+    double max_error;
+    std::vector<double> channel_max;
+    std::vector<double> channel_rmse;
+};
+
+// both images have the same size and row order
+ImageError compareImages(const unsigned char *image, const std::vector<double> &reference, int width, int height, int channels);
+
+#endif
@@ -55,17 +55,61 @@ Shader::Shader(const char* vertex_file_path, const char* frag_file_path)
     glAttachShader(ID, vertex);
     glAttachShader(ID, fragment);
     glLinkProgram(ID);
-    checkCompileErrors(ID, "PROGRAM");
+    valid = checkCompileErrors(ID, "PROGRAM");
 
     glDeleteShader(vertex);
     glDeleteShader(fragment);
 }
 
+Shader::Shader(const char* compute_file_path)
+{
+    std::string computeCode;
+    std::ifstream cShaderFile;
+
+    cShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+
+    try
+    {
+        cShaderFile.open(compute_file_path);
+
+        std::stringstream cShaderStream;
+        cShaderStream << cShaderFile.rdbuf();
+        cShaderFile.close();
+
+        computeCode = cShaderStream.str();
+    }
+    catch (std::ifstream::failure &e)
+    {
+        std::cerr << "ERROR: Shader file cannot be read successfully: " << e.what() << std::endl;
+    }
+
+    const char* cShaderCode = computeCode.c_str();
+
+    // compute shader
+    unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(compute, 1, &cShaderCode, NULL);
+    glCompileShader(compute);
+    checkCompileErrors(compute, "COMPUTE");
+
+    // shader program
+    ID = glCreateProgram();
+    glAttachShader(ID, compute);
+    glLinkProgram(ID);
+    valid = checkCompileErrors(ID, "PROGRAM");
+
+    glDeleteShader(compute);
+}
+
 GLuint Shader::getProgramID()
 {
     return this->ID;
 }
 
+bool Shader::isValid()
+{
+    return valid;
+}
+
 // call use program
 void Shader::use()
 {
@@ -87,17 +131,35 @@ void Shader::setInt(const std::string &name, int value)
 // sets a float value to a float uniform variable
 void Shader::setFloat(const std::string &name, float value)
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+}
+
+// sets two float values to a vec2 uniform variable
+void Shader::setVec2(const std::string &name, float x, float y)
+{
+    glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+}
+
+// sets two int values to an ivec2 uniform variable
+void Shader::setIVec2(const std::string &name, int x, int y)
+{
+    glUniform2i(glGetUniformLocation(ID, name.c_str()), x, y);
+}
+
+// sets count float values to a float array uniform variable
+void Shader::setFloatArray(const std::string &name, const float *values, int count)
+{
+    glUniform1fv(glGetUniformLocation(ID, name.c_str()), count, values);
 }
 
 // controls vertex and fragment shaders for errors
-// checks if linking is successful
-void Shader::checkCompileErrors(unsigned int shader, std::string type)
+// checks if linking is successful, returns false on any error
+bool Shader::checkCompileErrors(unsigned int shader, std::string type)
 {
     int success;
     char infoLog[1024]= {0};
 
-    if (type == "PROGRAM")
+    if (type != "PROGRAM")
     {
         glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
         if (!success)
@@ -116,4 +178,5 @@ void Shader::checkCompileErrors(unsigned int shader, std::string type)
             std::cerr << "ERROR: Shader linking error of type: " << type << "\n" << infoLog << std::endl; 
         }
     }
+    return success != 0;
 }
\ No newline at end of file
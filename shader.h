@@ -18,8 +18,12 @@ class Shader
     public:
         // constructor
         Shader(const char* vertex_file_path, const char* frag_file_path);
+        // compute shader program
+        explicit Shader(const char* compute_file_path);
 
         GLuint getProgramID();
+        // false if compiling or linking failed
+        bool isValid();
 
         void use();
         // sets a boolean value to a bool uniform variable
@@ -28,10 +32,17 @@ class Shader
         void setInt(const std::string &name, int value);
         // sets a float value to a float uniform variable
         void setFloat(const std::string &name, float value);
+        // sets two float values to a vec2 uniform variable
+        void setVec2(const std::string &name, float x, float y);
+        // sets two int values to an ivec2 uniform variable
+        void setIVec2(const std::string &name, int x, int y);
+        // sets count float values to a float array uniform variable
+        void setFloatArray(const std::string &name, const float *values, int count);
 
     private:
         GLuint ID;
-        void checkCompileErrors(unsigned int shader, std::string type);
+        bool valid;
+        bool checkCompileErrors(unsigned int shader, std::string type);
 };
 
 #endif
\ No newline at end of file
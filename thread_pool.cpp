@@ -0,0 +1,105 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threads) : stopping(false)
+{
+    if (threads <= 0)
+    {
+        threads = std::max(1, int(std::thread::hardware_concurrency()));
+    }
+
+    for (int i = 0; i < threads; ++i)
+    {
+        workers.push_back(std::thread(&ThreadPool::work, this));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+        workers[i].join();
+    }
+}
+
+int ThreadPool::size() const
+{
+    return int(workers.size());
+}
+
+void ThreadPool::submit(const std::function<void()> &job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(job);
+    }
+    condition.notify_one();
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int, int)> &fn)
+{
+    if (count <= 0)
+    {
+        return;
+    }
+
+    // a few ranges per thread so that uneven ranges still balance out
+    int ranges = std::min(count, size() * 4);
+    int step = (count + ranges - 1) / ranges;
+    ranges = (count + step - 1) / step;
+
+    if (ranges == 1)
+    {
+        fn(0, count);
+        return;
+    }
+
+    std::mutex done_mutex;
+    std::condition_variable done_condition;
+    int remaining = ranges;
+
+    for (int i = 0; i < ranges; ++i)
+    {
+        int begin = i * step;
+        int end = std::min(count, begin + step);
+        submit([&, begin, end]()
+        {
+            fn(begin, end);
+
+            std::lock_guard<std::mutex> lock(done_mutex);
+            if (--remaining == 0)
+            {
+                done_condition.notify_one();
+            }
+        });
+    }
+
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done_condition.wait(lock, [&]() { return remaining == 0; });
+}
+
+void ThreadPool::work()
+{
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+            if (stopping && jobs.empty())
+            {
+                return;
+            }
+            job = jobs.front();
+            jobs.pop_front();
+        }
+        job();
+    }
+}
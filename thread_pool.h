@@ -0,0 +1,38 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// fixed size pool of worker threads
+class ThreadPool
+{
+    public:
+        // 0 threads means one per hardware thread
+        explicit ThreadPool(int threads = 0);
+        ~ThreadPool();
+
+        int size() const;
+
+        // queues a job to be run by one of the workers
+        void submit(const std::function<void()> &job);
+
+        // splits [0, count) into ranges and calls fn(begin, end) for each of them in parallel
+        // returns after all ranges are processed
+        void parallelFor(int count, const std::function<void(int, int)> &fn);
+
+    private:
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()> > jobs;
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool stopping;
+
+        void work();
+};
+
+#endif
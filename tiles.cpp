@@ -0,0 +1,52 @@
+#include "tiles.h"
+
+#include <algorithm>
+#include <cstring>
+
+std::vector<Tile> splitTiles(int width, int height, int tile_size, int apron, int align)
+{
+    std::vector<Tile> tiles;
+    apron = (apron + align - 1) / align * align;
+    const int core = (tile_size - 2 * apron) / align * align;
+    if (core <= 0)
+    {
+        return tiles;
+    }
+
+    for (int y = 0; y < height; y += core)
+    {
+        for (int x = 0; x < width; x += core)
+        {
+            Tile tile;
+            tile.core_x = x;
+            tile.core_y = y;
+            tile.core_width = std::min(core, width - x);
+            tile.core_height = std::min(core, height - y);
+            tile.x = std::max(0, x - apron);
+            tile.y = std::max(0, y - apron);
+            tile.width = std::min(width, x + tile.core_width + apron) - tile.x;
+            tile.height = std::min(height, y + tile.core_height + apron) - tile.y;
+            tiles.push_back(tile);
+        }
+    }
+    return tiles;
+}
+
+void copyTile(const unsigned char *image, int width, int channels, const Tile &tile, unsigned char *pixels)
+{
+    const size_t row = size_t(tile.width) * channels;
+    for (int y = 0; y < tile.height; ++y)
+    {
+        memcpy(pixels + y * row, image + ((size_t(tile.y) + y) * width + tile.x) * channels, row);
+    }
+}
+
+void storeTile(const unsigned char *pixels, const Tile &tile, int channels, unsigned char *result, int width)
+{
+    const size_t row = size_t(tile.core_width) * channels;
+    for (int y = 0; y < tile.core_height; ++y)
+    {
+        const size_t source = (size_t(tile.core_y - tile.y + y) * tile.width + (tile.core_x - tile.x)) * channels;
+        memcpy(result + ((size_t(tile.core_y) + y) * width + tile.core_x) * channels, pixels + source, row);
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef __TILES_H__
+#define __TILES_H__
+
+#include <vector>
+
+// part of an image that is too large to be blurred at once
+// the tile is read with an apron of neighbouring pixels, only its core goes into the result
+struct Tile
+{
+    int x, y, width, height; // region that is read, core and apron clipped to the image
+    int core_x, core_y, core_width, core_height; // region that is written
+};
+
+// splits a width x height image into tiles of at most tile_size x tile_size pixels with their apron
+// cores and aprons are multiples of align, so an implementation working on a grid sees the same grid in every tile
+// returns no tiles if tile_size leaves no room for a core
+std::vector<Tile> splitTiles(int width, int height, int tile_size, int apron, int align);
+
+// copies the region of the tile out of an interleaved image of the given width into tile.width x tile.height pixels
+void copyTile(const unsigned char *image, int width, int channels, const Tile &tile, unsigned char *pixels);
+
+// copies the core of the blurred tile.width x tile.height pixels into the interleaved result of the given width
+void storeTile(const unsigned char *pixels, const Tile &tile, int channels, unsigned char *result, int width);
+
+#endif
@@ -0,0 +1,200 @@
+#include "video.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <sstream>
+#include <algorithm>
+
+// reads a line without the newline, false at the end of the file before any character
+static bool readLine(FILE *file, std::string &line)
+{
+    line.clear();
+    int c;
+    while ((c = fgetc(file)) != EOF && c != '\n')
+    {
+        line.push_back(char(c));
+    }
+    return c != EOF || !line.empty();
+}
+
+// size of a chroma plane, 0 for a luma only stream
+static size_t chromaSize(const VideoFormat &format)
+{
+    if (!format.chroma_x)
+    {
+        return 0;
+    }
+    return size_t((format.width + format.chroma_x - 1) / format.chroma_x) * ((format.height + format.chroma_y - 1) / format.chroma_y);
+}
+
+bool readVideoHeader(FILE *file, VideoFormat &format, std::string &error)
+{
+    std::string line;
+    if (!readLine(file, line) || line.compare(0, 10, "YUV4MPEG2 ") != 0)
+    {
+        error = "not a YUV4MPEG2 stream, raw RGB needs --video-size";
+        return false;
+    }
+
+    // the colorspace defaults to 4:2:0 with jpeg siting
+    format.y4m = true;
+    format.header = line;
+    format.width = format.height = 0;
+    format.chroma_x = format.chroma_y = 2;
+    std::istringstream tokens(line.substr(10));
+    std::string token;
+    while (tokens >> token)
+    {
+        const std::string value = token.substr(1);
+        switch (token[0])
+        {
+            case 'W': format.width = atoi(value.c_str()); break;
+            case 'H': format.height = atoi(value.c_str()); break;
+            case 'C':
+                if (value == "420jpeg" || value == "420paldv" || value == "420mpeg2" || value == "420")
+                {
+                    format.chroma_x = format.chroma_y = 2;
+                }
+                else if (value == "422")
+                {
+                    format.chroma_x = 2;
+                    format.chroma_y = 1;
+                }
+                else if (value == "411")
+                {
+                    format.chroma_x = 4;
+                    format.chroma_y = 1;
+                }
+                else if (value == "444")
+                {
+                    format.chroma_x = format.chroma_y = 1;
+                }
+                else if (value == "mono")
+                {
+                    format.chroma_x = format.chroma_y = 0;
+                }
+                else
+                {
+                    error = "unsupported colorspace C" + value + ", only 8-bit 4:2:0, 4:2:2, 4:1:1, 4:4:4 and mono";
+                    return false;
+                }
+                break;
+        }
+    }
+    if (format.width <= 0 || format.height <= 0)
+    {
+        error = "the stream header has no frame size";
+        return false;
+    }
+    return true;
+}
+
+bool writeVideoHeader(FILE *file, const VideoFormat &format)
+{
+    if (!format.y4m)
+    {
+        return true;
+    }
+    return fprintf(file, "%s\n", format.header.c_str()) > 0;
+}
+
+int readVideoFrame(FILE *file, const VideoFormat &format, unsigned char *pixels, std::vector<unsigned char> &scratch)
+{
+    const size_t luma = size_t(format.width) * format.height;
+    if (!format.y4m)
+    {
+        const size_t read = fread(pixels, 1, luma * 3, file);
+        if (read == 0 && feof(file) && !ferror(file))
+        {
+            return VIDEO_END;
+        }
+        return read == luma * 3 ? VIDEO_FRAME : VIDEO_BROKEN;
+    }
+
+    // frame parameters are dropped, the output frames have none
+    std::string line;
+    if (!readLine(file, line))
+    {
+        return ferror(file) ? VIDEO_BROKEN : VIDEO_END;
+    }
+    if (line.compare(0, 5, "FRAME") != 0)
+    {
+        return VIDEO_BROKEN;
+    }
+    const size_t chroma = chromaSize(format);
+    scratch.resize(luma + 2 * chroma);
+    if (fread(scratch.data(), 1, scratch.size(), file) != scratch.size())
+    {
+        return VIDEO_BROKEN;
+    }
+
+    const int chroma_width = format.chroma_x ? (format.width + format.chroma_x - 1) / format.chroma_x : 0;
+    for (int y = 0; y < format.height; ++y)
+    {
+        const unsigned char *luma_row = scratch.data() + size_t(y) * format.width;
+        unsigned char *row = pixels + size_t(y) * format.width * 3;
+        if (!format.chroma_x)
+        {
+            for (int x = 0; x < format.width; ++x)
+            {
+                row[3 * x] = luma_row[x];
+                row[3 * x + 1] = row[3 * x + 2] = 128;
+            }
+            continue;
+        }
+        const unsigned char *u = scratch.data() + luma + size_t(y / format.chroma_y) * chroma_width;
+        const unsigned char *v = u + chroma;
+        for (int x = 0; x < format.width; ++x)
+        {
+            row[3 * x] = luma_row[x];
+            row[3 * x + 1] = u[x / format.chroma_x];
+            row[3 * x + 2] = v[x / format.chroma_x];
+        }
+    }
+    return VIDEO_FRAME;
+}
+
+bool writeVideoFrame(FILE *file, const VideoFormat &format, const unsigned char *pixels, std::vector<unsigned char> &scratch)
+{
+    const size_t luma = size_t(format.width) * format.height;
+    if (!format.y4m)
+    {
+        return fwrite(pixels, 1, luma * 3, file) == luma * 3;
+    }
+
+    const size_t chroma = chromaSize(format);
+    scratch.resize(luma + 2 * chroma);
+    for (size_t i = 0; i < luma; ++i)
+    {
+        scratch[i] = pixels[3 * i];
+    }
+    if (format.chroma_x)
+    {
+        const int chroma_width = (format.width + format.chroma_x - 1) / format.chroma_x;
+        const int chroma_height = (format.height + format.chroma_y - 1) / format.chroma_y;
+        unsigned char *u = scratch.data() + luma;
+        unsigned char *v = u + chroma;
+        for (int cy = 0; cy < chroma_height; ++cy)
+        {
+            const int y0 = cy * format.chroma_y, y1 = std::min(y0 + format.chroma_y, format.height);
+            for (int cx = 0; cx < chroma_width; ++cx)
+            {
+                const int x0 = cx * format.chroma_x, x1 = std::min(x0 + format.chroma_x, format.width);
+                int sum_u = 0, sum_v = 0;
+                for (int y = y0; y < y1; ++y)
+                {
+                    const unsigned char *p = pixels + (size_t(y) * format.width + x0) * 3;
+                    for (int x = x0; x < x1; ++x, p += 3)
+                    {
+                        sum_u += p[1];
+                        sum_v += p[2];
+                    }
+                }
+                const int count = (y1 - y0) * (x1 - x0);
+                u[size_t(cy) * chroma_width + cx] = (unsigned char) ((sum_u + count / 2) / count);
+                v[size_t(cy) * chroma_width + cx] = (unsigned char) ((sum_v + count / 2) / count);
+            }
+        }
+    }
+    return fputs("FRAME\n", file) >= 0 && fwrite(scratch.data(), 1, scratch.size(), file) == scratch.size();
+}
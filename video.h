@@ -0,0 +1,40 @@
+#ifndef __VIDEO_H__
+#define __VIDEO_H__
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// a stream of frames, YUV4MPEG2 (Y4M) with 8-bit samples or raw top-down RGB of a given size
+struct VideoFormat
+{
+    int width, height;
+    bool y4m;
+    std::string header; // Y4M stream header line without the newline, the output repeats it
+    int chroma_x, chroma_y; // chroma subsampling, 2 and 2 for 4:2:0, 0 for a luma only stream
+
+    VideoFormat() : width(0), height(0), y4m(false), chroma_x(1), chroma_y(1) {}
+};
+
+// reads and parses the Y4M stream header, false with error for 10-bit and other unsupported streams
+bool readVideoHeader(FILE *file, VideoFormat &format, std::string &error);
+
+// repeats the stream header, raw RGB has none
+bool writeVideoHeader(FILE *file, const VideoFormat &format);
+
+// result of readVideoFrame
+enum VideoRead
+{
+    VIDEO_FRAME, // a whole frame was read
+    VIDEO_END, // the stream ended where a frame would start
+    VIDEO_BROKEN // the frame is cut short, its FRAME line is missing or reading failed
+};
+
+// reads the next frame as width x height interleaved 3 channel pixels, top-down
+// Y4M planes are interleaved as Y, U, V with every chroma sample repeated over its block (scratch holds the planes)
+int readVideoFrame(FILE *file, const VideoFormat &format, unsigned char *pixels, std::vector<unsigned char> &scratch);
+
+// writes a frame of interleaved pixels, Y4M chroma is averaged over its block again
+bool writeVideoFrame(FILE *file, const VideoFormat &format, const unsigned char *pixels, std::vector<unsigned char> &scratch);
+
+#endif